@@ -22,6 +22,8 @@ HEADERS += \
     ../include/tls_pointer.h \
     ../include/pool_alloc.h \
     ../include/buffer.h \
+    ../include/scheduler.h \
+    ../include/dispatcher.h \
     ../src/memory/detail.h \
     ../src/memory/alloc.h \
     ../src/memory/wrapper.h \
@@ -30,18 +32,25 @@ HEADERS += \
     ../src/platform/waiter_wrapper.h \
     ../src/circ/elem_def.h \
     ../src/circ/elem_array.h \
+    ../src/circ/byte_array.h \
     ../src/prod_cons.h \
     ../src/policy.h \
     ../src/queue.h \
     ../src/log.h \
-    ../src/id_pool.h
+    ../src/id_pool.h \
+    ../src/platform/ready_fd.h \
+    ../src/platform/affinity.h \
+    ../src/mpsc_queue.h
 
 SOURCES += \
     ../src/shm.cpp \
     ../src/ipc.cpp \
     ../src/pool_alloc.cpp \
     ../src/buffer.cpp \
-    ../src/waiter.cpp
+    ../src/waiter.cpp \
+    ../src/poller.cpp \
+    ../src/scheduler.cpp \
+    ../src/dispatcher.cpp
 
 unix {
 
@@ -5,6 +5,7 @@ QT -= gui
 
 CONFIG += console
 CONFIG += c++14 c++1z # may be useless
+CONFIG += c++2a # the coroutine awaitables are tested in C++20
 CONFIG -= app_bundle
 
 DESTDIR = ../output
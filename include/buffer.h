@@ -17,6 +17,8 @@ public:
     buffer();
 
     buffer(void* p, std::size_t s, destructor_t d);
+    // d would be called with additional instead of p
+    buffer(void* p, std::size_t s, destructor_t d, void* additional);
     buffer(void* p, std::size_t s);
 
     template <std::size_t N>
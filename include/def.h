@@ -26,9 +26,14 @@ using uint_t = typename uint<N>::type;
 // constants
 
 enum : std::size_t {
-    invalid_value  = (std::numeric_limits<std::size_t>::max)(),
-    data_length    = 64,
-    default_timeut = 100 // ms
+    invalid_value    = (std::numeric_limits<std::size_t>::max)(),
+    data_length      = 64,
+    var_length       = 0,   // DataSize of the channels carrying each message as one record
+    default_elem_max = 256, // ring capacity, rounded up to a power of 2
+    default_timeut   = 100, // ms
+    large_msg_limit  = 1024, // messages larger than this are stored in the shared chunks
+    large_msg_align  = 1024, // the smallest chunk size, the others are its multiples by the powers of 2
+    large_msg_cache  = 32    // chunks per chunk size
 };
 
 enum class relat { // multiplicity of the relationship
@@ -41,9 +46,72 @@ enum class trans { // transmission
     broadcast
 };
 
+/*
+ * What a sender does when the ring is full:
+ *  wait - waits for default_timeut, then forces the message in (the default of broadcast)
+ *  drop - forces the message in at once, so a send never waits
+ *  fail - waits for default_timeut, then fails (the default of unicast)
+ * Forcing drops the oldest messages of a unicast ring (except the fixed-size single-single one),
+ * which a unicast sender only does when asked to, since it loses the messages nobody has read.
+ * A broadcast ring evicts its lagging receivers instead.
+*/
+enum class overflow {
+    wait,
+    drop,
+    fail
+};
+
+/*
+ * How a connection waits for the ring (a message to receive, or a free slot to send):
+ *  spin     - polls it without a break, for a thread owning an isolated core
+ *  pause    - polls it with a cpu pause between the tries
+ *  adaptive - yields for a while, then blocks (the default)
+ *  block    - blocks at once, for the threads which shouldn't burn the cpu
+ * spin & pause never block, so the waiting thread keeps its core busy until the wait ends.
+ * A wait for another thread inside a push or a pop isn't covered, see chan_wrapper::set_wait.
+*/
+enum class wait_strategy {
+    spin,
+    pause,
+    adaptive,
+    block
+};
+
+/*
+ * The adaptive waits of a connection on one side (sending or receiving).
+ * A wait counts only if the ring isn't ready at the first try, & the polls (tm = 0) don't count.
+*/
+struct wait_stats {
+    std::uint64_t waits       = 0; // the waits
+    std::uint64_t spun        = 0; // the waits ended while spinning
+    std::uint64_t parked      = 0; // the waits blocked on the waiter, timeouts included
+    std::uint64_t wait_ns     = 0; // the total time of the waits
+    std::size_t   spin_budget = 0; // the yields before blocking at present
+};
+
 // producer-consumer policy flag
 
 template <relat Rp, relat Rc, trans Ts>
 struct wr {};
 
+/*
+ * Broadcast from a single producer to multi consumers,
+ * each consumer keeps its own cursor in shm instead of the read-counters of the elements,
+ * so the consumers never write the elements.
+*/
+struct wr_cursor {};
+
+/*
+ * Broadcast from a single producer to multi consumers, which never waits for the consumers:
+ * the oldest element is always overwritten, & the overrun consumers skip ahead,
+ * counting the elements they have lost.
+*/
+struct wr_lossy {};
+
+/*
+ * Multi producers to multi consumers (unicast), each element carries its own sequence,
+ * so a delayed producer only blocks its own element instead of the commits after it.
+*/
+struct wr_slot {};
+
 } // namespace ipc
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+#include "export.h"
+#include "def.h"
+#include "buffer.h"
+#include "ipc.h"
+
+namespace ipc {
+
+/*
+ * class dispatcher
+ *
+ * Owns the receiving loops of a set of channels, & calls a handler for each message on a worker pool.
+ * One receiver thread waits for all the channels by their readiness descriptors (see poller),
+ * takes at most batch messages of a channel at once (recv_batch), & hands them off to a worker
+ * through a lock-free queue. All the messages of a channel go to the same worker,
+ * so a handler is called in the order of its channel's messages.
+ *
+ * wait_strategy is the idle policy of the workers (spin & pause never park),
+ * & the handed-off messages are all handled before stop returns.
+ * With pin, the receiver is pinned to the cpu 0, & the worker i to the cpu (i + 1) % the cpu count.
+*/
+class IPC_EXPORT dispatcher {
+public:
+    using handler_t = std::function<void(buff_t)>;
+
+    explicit dispatcher(std::size_t workers = 1, std::size_t batch = 16, bool pin = false);
+    dispatcher(dispatcher&& rhs);
+
+    ~dispatcher();
+
+    void swap(dispatcher& rhs);
+    dispatcher& operator=(dispatcher rhs);
+
+    // the channels should be added before start, & live until stop
+    template <typename Flag, std::size_t DataSize>
+    bool add(chan_wrapper<Flag, DataSize>& ch, handler_t fn) {
+        using impl_t = chan_impl<Flag, DataSize>;
+        return add(ch.handle(), impl_t::ready_fd(ch.handle()), &impl_t::arm, &impl_t::recv_batch, std::move(fn));
+    }
+
+    void set_wait(wait_strategy ws);
+
+    bool start();
+    void stop ();
+
+    bool        running   () const;
+    std::size_t size      () const; // the count of the channels
+    std::size_t dispatched() const; // the count of the handled messages
+
+private:
+    bool add(handle_t h, int fd, bool (*arm)(handle_t),
+             std::vector<buff_t> (*recv_batch)(handle_t, std::size_t, std::size_t), handler_t fn);
+
+    class dispatcher_;
+    dispatcher_* p_;
+};
+
+} // namespace ipc
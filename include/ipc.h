@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <string>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
 
 #include "export.h"
 #include "def.h"
@@ -18,25 +21,51 @@ enum : unsigned {
     receiver
 };
 
-template <typename Flag>
+/*
+ * DataSize is the payload size of one ring slot,
+ * a message larger than it would be split into several fragments.
+ * The library is instantiated with DataSize = data_length (64), 256, 1024 & 4096.
+ *
+ * DataSize = var_length selects a byte ring instead,
+ * which stores each message as one contiguous record without splitting it.
+ * Its capacity is elem_max * data_length bytes.
+*/
+
+template <typename Flag, std::size_t DataSize = data_length>
 struct IPC_EXPORT chan_impl {
-    static handle_t connect   (char const * name, unsigned mode);
+    static handle_t connect   (char const * name, unsigned mode, std::size_t elem_max);
     static void     disconnect(handle_t h);
 
     static std::size_t recv_count(handle_t h);
+    static std::size_t lost_count(handle_t h);
     static bool wait_for_recv(handle_t h, std::size_t r_count, std::size_t tm);
 
     static bool   send(handle_t h, void const * data, std::size_t size);
     static buff_t recv(handle_t h, std::size_t tm);
 
+    static bool                send_batch(handle_t h, buff_t const * msgs, std::size_t n);
+    static std::vector<buff_t> recv_batch(handle_t h, std::size_t max, std::size_t tm);
+
     static bool   try_send(handle_t h, void const * data, std::size_t size);
+    static bool   sendable(handle_t h, std::size_t size);
     static buff_t try_recv(handle_t h);
+    static buff_t recv_view(handle_t h, std::size_t tm);
+
+    static void* loan  (handle_t h, std::size_t size);
+    static bool  commit(handle_t h);
+
+    static void set_overflow(handle_t h, overflow ov);
+    static void set_wait    (handle_t h, wait_strategy ws);
+    static wait_stats stats (handle_t h, unsigned mode);
+
+    static int  ready_fd(handle_t h);
+    static bool arm     (handle_t h);
 };
 
-template <typename Flag>
+template <typename Flag, std::size_t DataSize = data_length>
 class chan_wrapper {
 private:
-    using detail_t = chan_impl<Flag>;
+    using detail_t = chan_impl<Flag, DataSize>;
 
     handle_t    h_ = nullptr;
     std::string n_;
@@ -44,8 +73,14 @@ private:
 public:
     chan_wrapper() = default;
 
-    explicit chan_wrapper(char const * name, unsigned mode = sender) {
-        this->connect(name, mode);
+    /*
+     * elem_max is the ring capacity (in messages' fragments) of this channel,
+     * which would be rounded up to a power of 2.
+     * Only the first connection of a channel could decide it,
+     * the later ones would use the recorded capacity instead.
+    */
+    explicit chan_wrapper(char const * name, unsigned mode = sender, std::size_t elem_max = default_elem_max) {
+        this->connect(name, mode, elem_max);
     }
 
     chan_wrapper(chan_wrapper&& rhs) {
@@ -82,10 +117,10 @@ public:
         return chan_wrapper { name() };
     }
 
-    bool connect(char const * name, unsigned mode = sender | receiver) {
+    bool connect(char const * name, unsigned mode = sender | receiver, std::size_t elem_max = default_elem_max) {
         if (name == nullptr || name[0] == '\0') return false;
         this->disconnect();
-        h_ = detail_t::connect((n_ = name).c_str(), mode);
+        h_ = detail_t::connect((n_ = name).c_str(), mode, elem_max);
         return valid();
     }
 
@@ -100,6 +135,65 @@ public:
         return detail_t::recv_count(h_);
     }
 
+    /*
+     * lost_count is the count of the ring elements (message fragments)
+     * this receiver has skipped by being overrun.
+     * A wr_lossy channel loses them silently; on a broadcast channel (route, channel & wr_cursor)
+     * a sender blocked by this receiver evicts it, then its next recv goes on from the newest message.
+     * A var_length channel counts the skipped messages, once its receiver has read the next one.
+    */
+    std::size_t lost_count() const {
+        return detail_t::lost_count(h_);
+    }
+
+    /*
+     * set_overflow decides how this sender handles a full ring, see ipc::overflow.
+     * It's a setting of this connection only.
+    */
+    void set_overflow(overflow ov) {
+        detail_t::set_overflow(h_, ov);
+    }
+
+    /*
+     * set_wait decides how this connection waits in send & recv, see ipc::wait_strategy.
+     * It's a setting of this connection only, the default is wait_strategy::adaptive.
+     *
+     * It covers the waits for the ring (a message, or a free slot) only. A push or a pop might also wait
+     * for another thread in the middle of its own (a producer having claimed the slot before it,
+     * or the oldest element still being written), & these waits go by ipc::yield whatever the strategy is:
+     * they spin & pause for a few rounds, then yield the cpu (sched_yield) until the other one is done.
+    */
+    void set_wait(wait_strategy ws) {
+        detail_t::set_wait(h_, ws);
+    }
+
+    /*
+     * stats returns the statistics of the adaptive waits of this connection,
+     * in recv (mode = receiver) or in send (mode = sender).
+     * The spin budget is tuned by the waits, see ipc::wait_stats.
+    */
+    wait_stats stats(unsigned mode = receiver) const {
+        return detail_t::stats(h_, mode);
+    }
+
+    /*
+     * ready_fd returns a descriptor for an event loop (epoll, poll or select) on Linux,
+     * which becomes readable when a message is sent after this receiver armed it.
+     * It's -1 on failure, or on the other platforms. The handle owns it, don't close it.
+     *
+     * Since a sender signals only the armed descriptors, a loop should:
+     * arm(), then try_recv until it returns empty, then wait for the descriptor, & again.
+     * A signal for the messages received already is harmless, try_recv just returns empty.
+     * try_recv never waits, whatever the wait_strategy is.
+    */
+    int ready_fd() {
+        return detail_t::ready_fd(h_);
+    }
+
+    bool arm() {
+        return detail_t::arm(h_);
+    }
+
     bool wait_for_recv(std::size_t r_count, std::size_t tm = invalid_value) const {
         return detail_t::wait_for_recv(h_, r_count, tm);
     }
@@ -123,10 +217,102 @@ public:
     buff_t try_recv() {
         return detail_t::try_recv(h_);
     }
+
+    /*
+     * send_batch sends the messages in order, & wakes the receivers once per batch
+     * (or once more each time the ring is full), instead of once per message.
+     * recv_batch waits for the first message like recv, then returns at most max messages
+     * which have been already in the ring.
+    */
+    bool send_batch(buff_t const * msgs, std::size_t n) {
+        return detail_t::send_batch(h_, msgs, n);
+    }
+
+    template <typename C>
+    bool send_batch(C const & msgs) {
+        return this->send_batch(std::data(msgs), std::size(msgs));
+    }
+
+    std::vector<buff_t> recv_batch(std::size_t max, std::size_t tm = invalid_value) {
+        return detail_t::recv_batch(h_, max, tm);
+    }
+
+    /*
+     * recv_view returns the message without copying it on a var_length channel:
+     * the buffer points into the shared ring, & the record is released when it's destroyed.
+     * So it must be destroyed before disconnecting, & not be held for long,
+     * since the senders couldn't reuse the ring past it (a forced send on a broadcast ring fails
+     * rather than dropping a viewed record).
+     * The other channels return a reassembled copy, just like recv.
+    */
+    buff_t recv_view(std::size_t tm = invalid_value) {
+        return detail_t::recv_view(h_, tm);
+    }
+
+    /*
+     * loan returns size writable bytes for the next message, commit sends it.
+     * On a var_length channel the bytes are inside the shared ring, so nothing is copied;
+     * the other channels stage the message & copy it at commit.
+     * Only one loan could be outstanding per connection, & it should be committed soon,
+     * since the ring couldn't be reclaimed past it. Disconnecting cancels it.
+    */
+    void* loan(std::size_t size) {
+        return detail_t::loan(h_, size);
+    }
+
+    bool commit() {
+        return detail_t::commit(h_);
+    }
 };
 
-template <typename Flag>
-using chan = chan_wrapper<Flag>;
+template <typename Flag, std::size_t DataSize = data_length>
+using chan = chan_wrapper<Flag, DataSize>;
+
+/*
+ * class poller
+ *
+ * Waits for many receivers at once by their readiness descriptors (see ready_fd),
+ * so it only works on Linux.
+ * wait returns the handles which might have messages, the caller should try_recv
+ * each of them until it returns empty. They are armed again before being returned,
+ * so the messages sent while the caller is receiving would wake the next wait.
+ * A newly added handle is returned by the next wait at once (for the messages sent before).
+*/
+class IPC_EXPORT poller {
+public:
+    poller();
+    poller(poller&& rhs);
+
+    ~poller();
+
+    void swap(poller& rhs);
+    poller& operator=(poller rhs);
+
+    template <typename Flag, std::size_t DataSize>
+    bool add(chan_wrapper<Flag, DataSize>& ch) {
+        using impl_t = chan_impl<Flag, DataSize>;
+        return add(ch.handle(), impl_t::ready_fd(ch.handle()), &impl_t::arm);
+    }
+
+    template <typename Flag, std::size_t DataSize>
+    void remove(chan_wrapper<Flag, DataSize> const & ch) {
+        remove(ch.handle());
+    }
+
+    void        remove(handle_t h);
+    std::size_t size() const;
+
+    std::vector<handle_t> wait(std::size_t tm = invalid_value);
+
+private:
+    friend class scheduler;
+    friend class dispatcher;
+
+    bool add(handle_t h, int fd, bool (*arm)(handle_t));
+
+    class poller_;
+    poller_* p_;
+};
 
 /*
  * class route
@@ -151,4 +337,383 @@ using route = chan<ipc::wr<relat::single, relat::multi, trans::broadcast>>;
 
 using channel = chan<ipc::wr<relat::multi, relat::multi, trans::broadcast>>;
 
+/*
+ * latest_impl keeps only the newest value (of size bytes) of a name in two shared slots.
+ * Each slot is guarded by a sequence counter (a seqlock), & a publisher writes the older one,
+ * so publishing never waits for the readers, & at most a few rounds for the other publishers,
+ * & reading takes no lock & no CAS.
+ * A publisher which dies while writing leaves the other slot to the rest.
+ *
+ * Versions start from 1, & 0 means nothing has been published yet (or a failure).
+*/
+
+struct IPC_EXPORT latest_impl {
+    static handle_t connect   (char const * name, std::size_t size);
+    static void     disconnect(handle_t h);
+
+    static std::uint64_t version(handle_t h);
+    static bool          publish(handle_t h, void const * data);
+    static std::uint64_t read   (handle_t h, void * data);
+    static std::uint64_t wait   (handle_t h, std::uint64_t ver, std::size_t tm);
+};
+
+/*
+ * class latest
+ *
+ * A conflating channel: the publishers overwrite the value,
+ * & the readers always get the newest consistent copy of it, the intermediate ones are skipped.
+ * The first connection of a name decides the slot size,
+ * connecting with a T of another size would fail.
+*/
+
+template <typename T>
+class latest {
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+    handle_t    h_ = nullptr;
+    std::string n_;
+
+public:
+    latest() = default;
+
+    explicit latest(char const * name) {
+        this->connect(name);
+    }
+
+    latest(latest&& rhs) {
+        swap(rhs);
+    }
+
+    ~latest() {
+        disconnect();
+    }
+
+    void swap(latest& rhs) {
+        std::swap(h_, rhs.h_);
+        n_.swap(rhs.n_);
+    }
+
+    latest& operator=(latest rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    char const * name() const {
+        return n_.c_str();
+    }
+
+    handle_t handle() const {
+        return h_;
+    }
+
+    bool valid() const {
+        return (handle() != nullptr);
+    }
+
+    bool connect(char const * name) {
+        if (name == nullptr || name[0] == '\0') return false;
+        this->disconnect();
+        h_ = latest_impl::connect((n_ = name).c_str(), sizeof(T));
+        return valid();
+    }
+
+    void disconnect() {
+        if (!valid()) return;
+        latest_impl::disconnect(h_);
+        h_ = nullptr;
+        n_.clear();
+    }
+
+    /*
+     * publish could fail under concurrent publishers: if two others are writing older values
+     * into both slots, it retries for a few rounds, then fails (one of them might have died).
+     * A value superseded by a newer one meanwhile is skipped, & succeeds.
+    */
+    bool publish(T const & val) {
+        return latest_impl::publish(h_, &val);
+    }
+
+    std::uint64_t version() const {
+        return latest_impl::version(h_);
+    }
+
+    /*
+     * read copies the newest value into val, & returns its version.
+     * val is left untouched when it returns 0, which it also does
+     * if the slots keep being rewritten under it for a few rounds.
+    */
+    std::uint64_t read(T& val) const {
+        T tmp;
+        auto ver = latest_impl::read(h_, &tmp);
+        if (ver != 0) val = tmp;
+        return ver;
+    }
+
+    /*
+     * wait blocks until the version differs from ver, then returns the new version,
+     * or 0 on timeout.
+    */
+    std::uint64_t wait(std::uint64_t ver, std::size_t tm = invalid_value) const {
+        return latest_impl::wait(h_, ver, tm);
+    }
+};
+
+/*
+ * shard_impl gives each sender of a name its own single-producer broadcast ring (a shard),
+ * at most shard_max senders could be connected at the same time.
+ * The receivers merge the shards, round-robin by recv, or by the sending time by recv_ordered.
+*/
+
+struct IPC_EXPORT shard_impl {
+    enum : std::size_t {
+        shard_max = 64
+    };
+
+    static handle_t connect   (char const * name, unsigned mode, std::size_t elem_max);
+    static void     disconnect(handle_t h);
+
+    static std::size_t shard_count(handle_t h);
+    static std::size_t recv_count (handle_t h);
+
+    static bool   send(handle_t h, void const * data, std::size_t size);
+    static buff_t recv(handle_t h, std::size_t tm, bool ordered);
+};
+
+/*
+ * class sharded
+ *
+ * A many to many channel, in which the senders don't contend with each other at all:
+ * a sender only writes its own shard, & the receivers read all of them.
+ * The messages of a sender keep their order; between the senders,
+ * recv takes one message from each shard in turn, & recv_ordered takes the earliest sent one
+ * among the shards' next messages.
+ *
+ * A handle claims its shard at the first send without waiting for the receivers,
+ * which join the new shards whenever they receive, & miss the messages sent before that.
+ * Like any other channel, a send waits (default_timeut) only while no receiver has joined the shard yet.
+ * The shard is released when the handle is disconnected.
+*/
+
+class sharded {
+    handle_t    h_ = nullptr;
+    std::string n_;
+
+public:
+    sharded() = default;
+
+    explicit sharded(char const * name, unsigned mode = sender, std::size_t elem_max = default_elem_max) {
+        this->connect(name, mode, elem_max);
+    }
+
+    sharded(sharded&& rhs) {
+        swap(rhs);
+    }
+
+    ~sharded() {
+        disconnect();
+    }
+
+    void swap(sharded& rhs) {
+        std::swap(h_, rhs.h_);
+        n_.swap(rhs.n_);
+    }
+
+    sharded& operator=(sharded rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    char const * name() const {
+        return n_.c_str();
+    }
+
+    handle_t handle() const {
+        return h_;
+    }
+
+    bool valid() const {
+        return (handle() != nullptr);
+    }
+
+    bool connect(char const * name, unsigned mode = sender | receiver, std::size_t elem_max = default_elem_max) {
+        if (name == nullptr || name[0] == '\0') return false;
+        this->disconnect();
+        h_ = shard_impl::connect((n_ = name).c_str(), mode, elem_max);
+        return valid();
+    }
+
+    void disconnect() {
+        if (!valid()) return;
+        shard_impl::disconnect(h_);
+        h_ = nullptr;
+        n_.clear();
+    }
+
+    // the senders connected
+    std::size_t shard_count() const {
+        return shard_impl::shard_count(h_);
+    }
+
+    // the receivers connected
+    std::size_t recv_count() const {
+        return shard_impl::recv_count(h_);
+    }
+
+    bool send(void        const * data, std::size_t size) { return shard_impl::send(h_, data, size)           ; }
+    bool send(buff_t      const & buff)                   { return   this->send(buff.data(), buff.size())   ; }
+    bool send(std::string const & str)                    { return   this->send(str.c_str(), str.size() + 1); }
+
+    buff_t recv(std::size_t tm = invalid_value) {
+        return shard_impl::recv(h_, tm, false);
+    }
+
+    buff_t try_recv() {
+        return shard_impl::recv(h_, 0, false);
+    }
+
+    buff_t recv_ordered(std::size_t tm = invalid_value) {
+        return shard_impl::recv(h_, tm, true);
+    }
+};
+
+/*
+ * part_impl splits a channel into part_count multi-producer unicast rings (partitions),
+ * at most part_max partitions & part_max receivers.
+ * A message goes to the partition of its key's hash, & each partition is owned by one receiver.
+*/
+
+struct IPC_EXPORT part_impl {
+    enum : std::size_t {
+        part_max     = 64,
+        default_part = 8,
+        move_wait    = 10 // the default_timeut rounds a sender waits for a full partition's next owner
+    };
+
+    static handle_t connect   (char const * name, unsigned mode, std::size_t parts, std::size_t elem_max);
+    static void     disconnect(handle_t h);
+
+    static std::size_t part_count(handle_t h);
+    static std::size_t recv_count(handle_t h);
+    static std::size_t owned     (handle_t h); // the partitions owned by this receiver
+
+    static bool   send(handle_t h, void const * key, std::size_t key_size, void const * data, std::size_t size);
+    static buff_t recv(handle_t h, std::size_t tm);
+};
+
+/*
+ * class partitioned
+ *
+ * A many to many channel keeping the order per key across parallel receivers:
+ * the messages of a key always go to the same partition, which is read by one receiver at a time.
+ * The keys are hashed by their bytes, so the same key maps to the same partition in every process.
+ *
+ * The partitions are spread evenly over the connected receivers (the partition p goes to the receiver
+ * whose rank is p % the receiver count), & rebalanced when a receiver connects or disconnects.
+ * A receiver gives up its partitions no longer assigned & takes the new ones whenever it receives,
+ * so a partition only moves between two recv calls of its owner,
+ * & a partly received message is finished by its owner before the partition moves.
+ * The messages sent while a partition has no owner wait in it, & a sender to a full one waits for its next owner
+ * (at most move_wait * default_timeut, as the receiver it's assigned to might have died),
+ * while a full partition having an owner (or a channel without a receiver) fails the send after default_timeut.
+ * Only the first connection of a name could decide the partition count.
+*/
+
+class partitioned {
+    handle_t    h_ = nullptr;
+    std::string n_;
+
+public:
+    partitioned() = default;
+
+    explicit partitioned(char const * name, unsigned mode = sender,
+                         std::size_t parts = part_impl::default_part, std::size_t elem_max = default_elem_max) {
+        this->connect(name, mode, parts, elem_max);
+    }
+
+    partitioned(partitioned&& rhs) {
+        swap(rhs);
+    }
+
+    ~partitioned() {
+        disconnect();
+    }
+
+    void swap(partitioned& rhs) {
+        std::swap(h_, rhs.h_);
+        n_.swap(rhs.n_);
+    }
+
+    partitioned& operator=(partitioned rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    char const * name() const {
+        return n_.c_str();
+    }
+
+    handle_t handle() const {
+        return h_;
+    }
+
+    bool valid() const {
+        return (handle() != nullptr);
+    }
+
+    bool connect(char const * name, unsigned mode = sender | receiver,
+                 std::size_t parts = part_impl::default_part, std::size_t elem_max = default_elem_max) {
+        if (name == nullptr || name[0] == '\0') return false;
+        this->disconnect();
+        h_ = part_impl::connect((n_ = name).c_str(), mode, parts, elem_max);
+        return valid();
+    }
+
+    void disconnect() {
+        if (!valid()) return;
+        part_impl::disconnect(h_);
+        h_ = nullptr;
+        n_.clear();
+    }
+
+    std::size_t part_count() const {
+        return part_impl::part_count(h_);
+    }
+
+    // the receivers connected
+    std::size_t recv_count() const {
+        return part_impl::recv_count(h_);
+    }
+
+    // the partitions owned by this receiver now
+    std::size_t owned() const {
+        return part_impl::owned(h_);
+    }
+
+    bool send(std::uint64_t key, void const * data, std::size_t size) {
+        return part_impl::send(h_, &key, sizeof(key), data, size);
+    }
+
+    bool send(std::string const & key, void const * data, std::size_t size) {
+        return part_impl::send(h_, key.data(), key.size(), data, size);
+    }
+
+    template <typename K>
+    bool send(K const & key, buff_t const & buff) {
+        return this->send(key, buff.data(), buff.size());
+    }
+
+    template <typename K>
+    bool send(K const & key, std::string const & str) {
+        return this->send(key, str.c_str(), str.size() + 1);
+    }
+
+    buff_t recv(std::size_t tm = invalid_value) {
+        return part_impl::recv(h_, tm);
+    }
+
+    buff_t try_recv() {
+        return part_impl::recv(h_, 0);
+    }
+};
+
 } // namespace ipc
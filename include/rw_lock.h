@@ -58,6 +58,10 @@
 
 namespace ipc {
 
+inline void pause() noexcept {
+    IPC_LOCK_PAUSE_();
+}
+
 template <typename K>
 inline void yield(K& k) noexcept {
     if (k < 4)  { /* Do nothing */ }
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "export.h"
+#include "def.h"
+#include "buffer.h"
+#include "ipc.h"
+
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+#include <coroutine>
+#endif
+
+namespace ipc {
+
+/*
+ * class scheduler
+ *
+ * Runs the asynchronous receivings & sendings of many channels on one thread,
+ * so a lot of logical consumers need no thread of their own.
+ * A receiving is completed when its channel has a message, which is checked by try_recv (never waiting)
+ * when the readiness descriptor is signaled (see poller),
+ * & a sending is completed when try_send succeeds, which is retried every turn
+ * (there is no readiness for the writers, so run_once waits at most 1 ms while any sending is pending).
+ * A sending which could never succeed (the message is too large for the ring,
+ * or a broadcast channel has no receiver) is completed with false instead.
+ * The operations of a channel are completed in order.
+ *
+ * It isn't thread-safe: async_recv, async_send & run_once should be called on the running thread,
+ * the completions (& the coroutines awaiting them) are run inside run_once.
+*/
+class IPC_EXPORT scheduler {
+public:
+    using recv_fn = std::function<void(buff_t)>;
+    using send_fn = std::function<void(bool)>;
+
+    scheduler();
+    scheduler(scheduler&& rhs);
+
+    ~scheduler();
+
+    void swap(scheduler& rhs);
+    scheduler& operator=(scheduler rhs);
+
+    template <typename Flag, std::size_t DataSize>
+    bool async_recv(chan_wrapper<Flag, DataSize>& ch, recv_fn fn) {
+        using impl_t = chan_impl<Flag, DataSize>;
+        return async_recv(ch.handle(), impl_t::ready_fd(ch.handle()), &impl_t::arm, &impl_t::try_recv, std::move(fn));
+    }
+
+    // the data is sent as it is, a buffer without a destructor should live until the completion
+    template <typename Flag, std::size_t DataSize>
+    bool async_send(chan_wrapper<Flag, DataSize>& ch, buff_t data, send_fn fn) {
+        using impl_t = chan_impl<Flag, DataSize>;
+        return async_send(ch.handle(), &impl_t::try_send, &impl_t::sendable, std::move(data), std::move(fn));
+    }
+
+    // drops the pending operations of a channel without completing them
+    template <typename Flag, std::size_t DataSize>
+    void remove(chan_wrapper<Flag, DataSize> const & ch) {
+        remove(ch.handle());
+    }
+
+    void remove(handle_t h);
+
+    // the count of the pending operations
+    std::size_t pending() const;
+
+    // completes the ready operations, waiting for them at most tm ms, returns the count of the completions
+    std::size_t run_once(std::size_t tm = invalid_value);
+
+    // runs until there is no pending operation
+    void run();
+
+private:
+    bool async_recv(handle_t h, int fd, bool (*arm)(handle_t), buff_t (*try_recv)(handle_t), recv_fn fn);
+    bool async_send(handle_t h, bool (*try_send)(handle_t, void const *, std::size_t),
+                    bool (*sendable)(handle_t, std::size_t), buff_t data, send_fn fn);
+
+    class scheduler_;
+    scheduler_* p_;
+};
+
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+
+/*
+ * The awaitables of C++20 coroutines, which are resumed by scheduler::run_once:
+ *
+ *  buff_t buf = co_await ipc::async_recv(sch, ch);
+ *  bool   ok  = co_await ipc::async_send(sch, ch, data, size);
+ *
+ * They don't suspend if the channel is ready at once.
+ * An empty buffer (or false) is returned if the operation couldn't be scheduled.
+*/
+
+template <typename Flag, std::size_t DataSize>
+class recv_awaiter {
+    scheduler                   & sch_;
+    chan_wrapper<Flag, DataSize>& ch_;
+    buff_t                        buf_;
+
+public:
+    recv_awaiter(scheduler& sch, chan_wrapper<Flag, DataSize>& ch)
+        : sch_(sch), ch_(ch) {
+    }
+
+    bool await_ready() {
+        buf_ = ch_.try_recv();
+        return !buf_.empty();
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        return sch_.async_recv(ch_, [this, h](buff_t buf) {
+            buf_ = std::move(buf);
+            h.resume();
+        });
+    }
+
+    buff_t await_resume() {
+        return std::move(buf_);
+    }
+};
+
+template <typename Flag, std::size_t DataSize>
+class send_awaiter {
+    scheduler                   & sch_;
+    chan_wrapper<Flag, DataSize>& ch_;
+    void const *                  data_;
+    std::size_t                   size_;
+    bool                          ok_ = false;
+
+public:
+    send_awaiter(scheduler& sch, chan_wrapper<Flag, DataSize>& ch, void const * data, std::size_t size)
+        : sch_(sch), ch_(ch), data_(data), size_(size) {
+    }
+
+    bool await_ready() {
+        return ok_ = ch_.try_send(data_, size_);
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        // the data lives in the suspended coroutine
+        return sch_.async_send(ch_, buff_t { const_cast<void*>(data_), size_ }, [this, h](bool ok) {
+            ok_ = ok;
+            h.resume();
+        });
+    }
+
+    bool await_resume() const noexcept {
+        return ok_;
+    }
+};
+
+template <typename Flag, std::size_t DataSize>
+recv_awaiter<Flag, DataSize> async_recv(scheduler& sch, chan_wrapper<Flag, DataSize>& ch) {
+    return { sch, ch };
+}
+
+template <typename Flag, std::size_t DataSize>
+send_awaiter<Flag, DataSize> async_send(scheduler& sch, chan_wrapper<Flag, DataSize>& ch,
+                                        void const * data, std::size_t size) {
+    return { sch, ch, data, size };
+}
+
+template <typename Flag, std::size_t DataSize>
+send_awaiter<Flag, DataSize> async_send(scheduler& sch, chan_wrapper<Flag, DataSize>& ch, buff_t const & buff) {
+    return { sch, ch, buff.data(), buff.size() };
+}
+
+#endif/*__cpp_impl_coroutine*/
+
+} // namespace ipc
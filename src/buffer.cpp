@@ -14,14 +14,15 @@ public:
     void*        p_;
     std::size_t  s_;
     destructor_t d_;
+    void*        a_;
 
-    buffer_(void* p, std::size_t s, destructor_t d)
-        : p_(p), s_(s), d_(d) {
+    buffer_(void* p, std::size_t s, destructor_t d, void* a)
+        : p_(p), s_(s), d_(d), a_(a) {
     }
 
     ~buffer_() {
         if (d_ == nullptr) return;
-        d_(p_, s_);
+        d_((a_ == nullptr) ? p_ : a_, s_);
     }
 };
 
@@ -30,7 +31,11 @@ buffer::buffer()
 }
 
 buffer::buffer(void* p, std::size_t s, destructor_t d)
-    : p_(p_->make(p, s, d)) {
+    : p_(p_->make(p, s, d, nullptr)) {
+}
+
+buffer::buffer(void* p, std::size_t s, destructor_t d, void* additional)
+    : p_(p_->make(p, s, d, additional)) {
 }
 
 buffer::buffer(void* p, std::size_t s)
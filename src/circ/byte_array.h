@@ -0,0 +1,551 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "def.h"
+#include "log.h"
+#include "rw_lock.h"
+
+#include "circ/elem_def.h"
+#include "platform/detail.h"
+
+namespace ipc {
+namespace circ {
+
+/*
+ * A byte-granular ring, each message is stored as one contiguous record,
+ * which is led by a header holding its size, commit flag & read-counter.
+ * A record that doesn't fit the rest of the ring is preceded by a padding record,
+ * which fills the ring up to its end & would be skipped by the readers.
+ *
+ * The space is reclaimed in order: fr_ moves over the records
+ * which have been committed & read by all the consumers.
+ *
+ * A broadcast record carries the bits of the readers which still have to read it (see reader_bits),
+ * so force_push evicts only the readers lagging on the oldest record, without touching the connection count.
+ * An evicted reader notices it by fr_, & goes on from the newest record,
+ * the records are numbered for counting the skipped ones.
+ * A record viewed in place (see pop_view) counts its viewers,
+ * force_push fails rather than dropping it.
+*/
+template <typename Flag>
+class byte_array;
+
+template <relat Rp, relat Rc, trans Ts>
+class byte_array<wr<Rp, Rc, Ts>> : public ipc::circ::conn_head
+                                 , public ipc::circ::reader_bits<std::uint64_t> {
+public:
+    using base_t   = ipc::circ::conn_head;
+    using policy_t = wr<Rp, Rc, Ts>;
+    using pos_t    = std::uint64_t;
+
+    struct cursor_t {
+        pos_t       rd_;   // read position (broadcast)
+        u2_t        id_;   // the reader's bit, reader_max if the reader isn't registered
+        std::size_t lost_; // the records skipped by being evicted
+        pos_t       sq_;   // the number of the next record
+
+        friend bool operator==(cursor_t const & a, cursor_t const & b) noexcept {
+            return a.rd_ == b.rd_;
+        }
+    };
+
+    enum : std::size_t {
+        unit_size = data_length,             // the ring holds elem_max units
+        rec_align = alignof(std::max_align_t)
+    };
+
+private:
+    using rc_t = std::uint64_t;
+
+    enum : rc_t {
+        rc_mask = 0x00000000ffffffffull      // readers' bits, the high bits tag the position
+    };
+
+    // a ring is at most elem_max_lim units (1GB), so a size fits in 32 bits with the skip bit
+    using sz_t = std::uint32_t;
+
+    enum : std::size_t {
+        skip_bit = static_cast<sz_t>(~((std::numeric_limits<sz_t>::max)() >> 1)), // the readers would skip it
+        pad_size = (std::numeric_limits<sz_t>::max)()
+    };
+
+    enum : sz_t {
+        vw_drop = (std::numeric_limits<sz_t>::max)() // the record has been dropped by force_push
+    };
+
+    struct alignas(rec_align) rec_t {
+        std::atomic<pos_t> f_ct_; // commit flag
+        std::atomic<rc_t>  rc_;   // read-counter
+        std::atomic<sz_t>  size_; // payload size
+        std::atomic<sz_t>  vw_;   // the readers viewing it in place (broadcast), or vw_drop
+        std::atomic<pos_t> sq_;   // record number, 0 for a padding
+    };
+
+    struct no_lock {
+        void lock  () noexcept {}
+        void unlock() noexcept {}
+    };
+
+    using lock_t = std::conditional_t<Rp == relat::multi, ipc::spin_lock, no_lock>;
+
+    alignas(cache_line_size) std::atomic<pos_t> wt_; // reserved position
+    lock_t lc_wt_;
+    std::atomic<pos_t> sq_;                          // records reserved, updated under lc_wt_
+    alignas(cache_line_size) std::atomic<pos_t> rd_; // read position (unicast)
+    alignas(cache_line_size) std::atomic<pos_t> fr_; // bytes before it are free
+
+public:
+    constexpr static std::size_t block_size(std::size_t elem_max) noexcept {
+        return unit_size * circ::elem_max_of(elem_max);
+    }
+
+    /*
+     * The ring is placed right after the head,
+     * so a byte_array must be allocated with size_of(elem_max) bytes.
+    */
+    constexpr static std::size_t size_of(std::size_t elem_max) noexcept {
+        return sizeof(byte_array) + block_size(elem_max);
+    }
+
+private:
+    byte_t* block() noexcept {
+        static_assert(alignof(byte_array) % alignof(rec_t) == 0, "unaligned block");
+        return reinterpret_cast<byte_t*>(this + 1);
+    }
+
+    std::size_t ring_size() const noexcept {
+        return unit_size * elem_max();
+    }
+
+    std::size_t offset_of(pos_t pos) const noexcept {
+        return static_cast<std::size_t>(pos) & (ring_size() - 1);
+    }
+
+    rec_t* rec_at(pos_t pos) noexcept {
+        return reinterpret_cast<rec_t*>(block() + offset_of(pos));
+    }
+
+    /*
+     * Records are sized in whole headers,
+     * so the tail of the ring always has room for a padding record.
+    */
+    constexpr static std::size_t rec_size(std::size_t size) noexcept {
+        static_assert(unit_size % sizeof(rec_t) == 0, "the ring must be a whole number of headers");
+        return (size + sizeof(rec_t) * 2 - 1) / sizeof(rec_t) * sizeof(rec_t);
+    }
+
+    std::size_t length_of(pos_t pos, std::size_t size) const noexcept {
+        return (size == pad_size) ? (ring_size() - offset_of(pos)) : rec_size(size & ~skip_bit);
+    }
+
+    constexpr static rc_t tag_of(pos_t pos) noexcept {
+        return static_cast<rc_t>(pos) << 32;
+    }
+
+    // the bits a new record is read by, a unicast one is read once
+    rc_t readers() const noexcept {
+        return (Ts == trans::broadcast) ? static_cast<rc_t>(live()) : 1;
+    }
+
+    constexpr static rc_t bit_of(cursor_t const & cur) noexcept {
+        return (Ts == trans::broadcast) ? (static_cast<rc_t>(1) << cur.id_) : 1;
+    }
+
+    // the bits of the readers which are still to read the record at pos
+    rc_t pending(rc_t rc, pos_t pos) const noexcept {
+        if (Ts == trans::broadcast) {
+            return lagging(static_cast<mask_t>(rc & rc_mask), pos);
+        }
+        return rc & rc_mask;
+    }
+
+    void reclaim() noexcept {
+        for (unsigned k = 0;;) {
+            auto cur_fr = fr_.load(std::memory_order_acquire);
+            if (cur_fr == wt_.load(std::memory_order_acquire)) {
+                return; // empty
+            }
+            auto* rec = rec_at(cur_fr);
+            if (rec->f_ct_.load(std::memory_order_acquire) != ~cur_fr) {
+                return; // not committed yet
+            }
+            if (pending(rec->rc_.load(std::memory_order_acquire), cur_fr)) {
+                return; // still being read
+            }
+            if (Ts == trans::broadcast) {
+                // an evicted reader isn't pending, but might still be viewing it, pairs with the fence in hold
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (rec->vw_.load(std::memory_order_relaxed) != 0) return;
+            }
+            auto len = length_of(cur_fr, rec->size_.load(std::memory_order_relaxed));
+            if (!fr_.compare_exchange_weak(cur_fr, cur_fr + len, std::memory_order_acq_rel)) {
+                ipc::yield(k);
+            }
+        }
+    }
+
+    void release(rec_t* rec, pos_t pos, rc_t bit) noexcept {
+        for (unsigned k = 0;;) {
+            auto cur_rc = rec->rc_.load(std::memory_order_acquire);
+            if (((cur_rc ^ tag_of(pos)) & ~rc_t(rc_mask)) || !(cur_rc & bit)) {
+                return; // it has been dropped by force_push, or it isn't read by this reader
+            }
+            if (rec->rc_.compare_exchange_weak(cur_rc, cur_rc & ~bit, std::memory_order_acq_rel)) {
+                if (!pending(cur_rc & ~bit, pos)) reclaim();
+                return;
+            }
+            ipc::yield(k);
+        }
+    }
+
+    /*
+     * Counts a viewer of the record at pos, fails if it has been dropped meanwhile.
+     * The header might have been reused by a newer record, which is noticed by fr_;
+     * a newer record is published after fr_ moved, & vw_ is stored with release for that.
+     * An evicted reader isn't counted by reclaim, so it fails as well, & rejoins.
+    */
+    bool hold(rec_t* rec, pos_t pos, cursor_t const & cur) noexcept {
+        auto cur_vw = rec->vw_.load(std::memory_order_acquire);
+        while (cur_vw != vw_drop) {
+            if (rec->vw_.compare_exchange_weak(cur_vw, cur_vw + 1, std::memory_order_acq_rel)) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!evicted(cur.id_) && (pos >= fr_.load(std::memory_order_acquire))) return true;
+                rec->vw_.fetch_sub(1, std::memory_order_acq_rel);
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Drops the oldest records & evicts the readers lagging on them, they would notice it by fr_.
+     * A viewed record (see hold) is never dropped, the force fails instead.
+    */
+    template <typename F>
+    bool drop_oldest(F&& fits, std::true_type /*broadcast*/) noexcept {
+        for (unsigned k = 0; !fits();) {
+            auto cur_fr = fr_.load(std::memory_order_acquire);
+            auto* rec = rec_at(cur_fr);
+            if (rec->f_ct_.load(std::memory_order_acquire) != ~cur_fr) {
+                return false; // another producer is still writing it
+            }
+            sz_t cur_vw = 0;
+            if (!rec->vw_.compare_exchange_strong(cur_vw, vw_drop, std::memory_order_acq_rel) &&
+                (cur_vw != vw_drop)) {
+                return false; // a reader is holding a view of it
+            }
+            evict(static_cast<mask_t>(pending(rec->rc_.load(std::memory_order_acquire), cur_fr)));
+            auto nxt_fr = cur_fr + length_of(cur_fr, rec->size_.load(std::memory_order_relaxed));
+            if (!fr_.compare_exchange_weak(cur_fr, nxt_fr, std::memory_order_acq_rel)) {
+                ipc::yield(k);
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Drops the oldest records nobody has taken, by moving rd_ over them as a consumer would.
+     * A record being read by a consumer is never dropped, so it fails if the oldest one is taken.
+    */
+    template <typename F>
+    bool drop_oldest(F&& fits, std::false_type /*unicast*/) noexcept {
+        for (unsigned k = 0; !fits();) {
+            auto cur_rd = rd_.load(std::memory_order_acquire);
+            if (fr_.load(std::memory_order_acquire) != cur_rd) {
+                reclaim();
+                if (fr_.load(std::memory_order_acquire) != cur_rd) {
+                    return false; // a consumer is still reading it
+                }
+            }
+            if (cur_rd == wt_.load(std::memory_order_acquire)) {
+                return false; // empty
+            }
+            auto* rec = rec_at(cur_rd);
+            if (rec->f_ct_.load(std::memory_order_acquire) != ~cur_rd) {
+                return false; // another producer is still writing it
+            }
+            auto len = length_of(cur_rd, rec->size_.load(std::memory_order_relaxed));
+            if (!rd_.compare_exchange_weak(cur_rd, cur_rd + len, std::memory_order_acq_rel)) {
+                ipc::yield(k);
+                continue;
+            }
+            release(rec, cur_rd, 1); // reclaims it
+        }
+        return true;
+    }
+
+    bool has_room(pos_t cur_wt, std::size_t len, bool force) noexcept {
+        auto fits = [this, cur_wt, len] {
+            return cur_wt + len - fr_.load(std::memory_order_acquire) <= ring_size();
+        };
+        if (fits()) return true;
+        reclaim();
+        if (fits()) return true;
+        if (!force) return false;
+        return drop_oldest(fits, std::integral_constant<bool, Ts == trans::broadcast>{});
+    }
+
+    void prepare(rec_t* rec, pos_t pos, std::size_t size, rc_t rc, pos_t sq) noexcept {
+        rec->size_.store(static_cast<sz_t>(size), std::memory_order_relaxed);
+        rec->rc_  .store(tag_of(pos) | rc, std::memory_order_relaxed);
+        rec->sq_  .store(sq, std::memory_order_relaxed);
+        rec->vw_  .store(0, std::memory_order_release);
+    }
+
+    /*
+     * Reserves a record for size bytes,
+     * it would be invisible to the readers until commit(pos).
+    */
+    rec_t* reserve(std::size_t size, bool force, pos_t& pos) {
+        if (size > max_size()) return nullptr; // too large
+        auto len = rec_size(size);
+        pos_t cur_wt, sq;
+        rc_t  rc;
+        {
+            IPC_UNUSED_ auto guard = ipc::detail::unique_lock(lc_wt_);
+            if ((rc = readers()) == 0) {
+                return nullptr; // no reader
+            }
+            while (1) {
+                cur_wt = wt_.load(std::memory_order_relaxed);
+                auto tail = ring_size() - offset_of(cur_wt);
+                if (!has_room(cur_wt, (ipc::detail::min)(len, tail), force)) {
+                    return nullptr; // full
+                }
+                auto* rec = rec_at(cur_wt);
+                // the header must be cleared before the readers could see it
+                rec->f_ct_.store(0, std::memory_order_relaxed);
+                if (len <= tail) {
+                    wt_.store(cur_wt + len, std::memory_order_release);
+                    break;
+                }
+                // wrap around by a padding record
+                prepare(rec, cur_wt, pad_size, rc, 0);
+                rec->f_ct_.store(~cur_wt, std::memory_order_release);
+                wt_.store(cur_wt + tail, std::memory_order_release);
+            }
+            sq = sq_.load(std::memory_order_relaxed) + 1;
+            sq_.store(sq, std::memory_order_relaxed);
+        }
+        auto* rec = rec_at(cur_wt);
+        prepare(rec, cur_wt, size, rc, sq);
+        pos = cur_wt;
+        return rec;
+    }
+
+    template <typename F>
+    bool push(std::size_t size, F&& f, bool force) {
+        pos_t pos;
+        auto* rec = reserve(size, force, pos);
+        if (rec == nullptr) return false;
+        std::forward<F>(f)(rec + 1);
+        commit(pos);
+        return true;
+    }
+
+    /*
+     * Takes the next readable record, the padding & cancelled ones are passed over.
+     * The taken record wouldn't be reclaimed before release(rec, pos).
+    */
+    rec_t* acquire(cursor_t& cur, pos_t& pos, std::size_t& size, std::true_type /*broadcast*/) {
+        auto bit = bit_of(cur);
+        while (1) {
+            auto cur_fr = fr_.load(std::memory_order_acquire);
+            if (cur.rd_ < cur_fr) {
+                // the records have been dropped, an evicted reader takes its bit back at the newest one
+                if (!evicted(cur.id_)) cur.rd_ = cur_fr;
+                else rejoin(cur.id_, cur.rd_ = wt_.load(std::memory_order_acquire));
+                continue;
+            }
+            if (cur.rd_ == wt_.load(std::memory_order_acquire)) {
+                return nullptr; // empty
+            }
+            auto* rec = rec_at(cur.rd_);
+            if (rec->f_ct_.load(std::memory_order_acquire) != ~cur.rd_) {
+                return nullptr; // not committed yet
+            }
+            size    = rec->size_.load(std::memory_order_relaxed);
+            auto rc = rec->rc_  .load(std::memory_order_relaxed);
+            auto sq = rec->sq_  .load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (cur.rd_ < fr_.load(std::memory_order_relaxed)) {
+                continue; // dropped while being checked
+            }
+            pos = cur.rd_;
+            cur.rd_ += length_of(pos, size);
+            if (!(rc & bit)) {
+                continue; // pushed while this reader was joining, it's protected from the next one
+            }
+            if (size != pad_size) {
+                if (sq > cur.sq_) cur.lost_ += static_cast<std::size_t>(sq - cur.sq_);
+                cur.sq_ = sq + 1;
+            }
+            if (!(size & skip_bit)) return rec;
+            release(rec, pos, bit);
+        }
+    }
+
+    rec_t* acquire(cursor_t& /*cur*/, pos_t& pos, std::size_t& size, std::false_type /*unicast*/) {
+        for (unsigned k = 0;;) {
+            auto cur_rd = rd_.load(std::memory_order_acquire);
+            if (cur_rd == wt_.load(std::memory_order_acquire)) {
+                return nullptr; // empty
+            }
+            auto* rec = rec_at(cur_rd);
+            if (rec->f_ct_.load(std::memory_order_acquire) != ~cur_rd) {
+                if (cur_rd == rd_.load(std::memory_order_acquire)) {
+                    return nullptr; // not committed yet
+                }
+                continue;
+            }
+            size = rec->size_.load(std::memory_order_relaxed);
+            if (!rd_.compare_exchange_weak(cur_rd, cur_rd + length_of(cur_rd, size), std::memory_order_acq_rel)) {
+                ipc::yield(k);
+                continue;
+            }
+            // the record has been taken by this consumer
+            pos = cur_rd;
+            if (!(size & skip_bit)) return rec;
+            release(rec, pos, 1);
+        }
+    }
+
+    rec_t* acquire(cursor_t& cur, pos_t& pos, std::size_t& size) {
+        return acquire(cur, pos, size, std::integral_constant<bool, Ts == trans::broadcast>{});
+    }
+
+public:
+    // a broadcast reader takes a bit, & reads from the newest record
+    cursor_t connect_reader() noexcept {
+        if (Ts != trans::broadcast) {
+            connect();
+            return { 0, 0, 0, 0 };
+        }
+        auto id = claim_id();
+        if (id >= reader_max) {
+            ipc::error("fail: connect, there are too many readers (%u)\n", static_cast<unsigned>(reader_max));
+            return cursor();
+        }
+        connect();
+        auto cur_wt = wt_.load(std::memory_order_acquire);
+        rejoin(id, cur_wt);
+        return { cur_wt, id, 0, sq_.load(std::memory_order_relaxed) + 1 };
+    }
+
+    bool registered(cursor_t const & cur) const noexcept {
+        return cur.id_ < reader_max;
+    }
+
+    void disconnect_reader(cursor_t const & cur) noexcept {
+        if (!registered(cur)) return;
+        if (Ts == trans::broadcast) leave(cur.id_);
+        disconnect();
+    }
+
+    cursor_t cursor() const noexcept {
+        return { (Ts == trans::broadcast) ? wt_.load(std::memory_order_acquire) : 0, reader_max, 0, 0 };
+    }
+
+    // the largest payload one record could carry
+    std::size_t max_size() const noexcept {
+        return ring_size() - sizeof(rec_t);
+    }
+
+    template <typename F>
+    bool push(std::size_t size, F&& f) {
+        return push(size, std::forward<F>(f), false);
+    }
+
+    // drops the oldest records for making room, see drop_oldest
+    template <typename F>
+    bool force_push(std::size_t size, F&& f) {
+        return push(size, std::forward<F>(f), true);
+    }
+
+    /*
+     * Loans size bytes inside the ring for writing in place.
+     * The loaned record blocks the reclaiming of the ones behind it,
+     * so it should be committed (or cancelled) soon.
+    */
+    void* loan(std::size_t size, pos_t& pos) {
+        auto* rec = reserve(size, false, pos);
+        return (rec == nullptr) ? nullptr : rec + 1;
+    }
+
+    void* force_loan(std::size_t size, pos_t& pos) {
+        auto* rec = reserve(size, true, pos);
+        return (rec == nullptr) ? nullptr : rec + 1;
+    }
+
+    // publishes the record reserved at pos, a cancelled one would be skipped by the readers
+    void commit(pos_t pos, bool cancel = false) noexcept {
+        auto* rec = rec_at(pos);
+        if (cancel) {
+            rec->size_.store(rec->size_.load(std::memory_order_relaxed) | static_cast<sz_t>(skip_bit), std::memory_order_relaxed);
+        }
+        rec->f_ct_.store(~pos, std::memory_order_release);
+    }
+
+    /*
+     * The payload is copied out before checking fr_ again on broadcast,
+     * so f might be called more than once if the record was dropped meanwhile.
+    */
+    template <typename F>
+    bool pop(cursor_t* cur, F&& f) {
+        if (cur == nullptr) return false;
+        while (1) {
+            pos_t pos;
+            std::size_t size;
+            auto* rec = acquire(*cur, pos, size);
+            if (rec == nullptr) return false;
+            f(static_cast<void*>(rec + 1), size);
+            if (Ts == trans::broadcast) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (pos < fr_.load(std::memory_order_relaxed)) {
+                    continue; // overwritten while reading
+                }
+            }
+            release(rec, pos, bit_of(*cur));
+            return true;
+        }
+    }
+
+    /*
+     * Pops the next record without copying it, the returned payload stays valid
+     * until release(cur, pos). On broadcast, the viewers are counted in vw_,
+     * so force_push wouldn't drop the record meanwhile.
+    */
+    void* pop_view(cursor_t* cur, std::size_t& size, pos_t& pos) {
+        if (cur == nullptr) return nullptr;
+        while (1) {
+            auto* rec = acquire(*cur, pos, size);
+            if (rec == nullptr) return nullptr;
+            if ((Ts != trans::broadcast) || hold(rec, pos, *cur)) {
+                return rec + 1;
+            }
+            release(rec, pos, bit_of(*cur));
+            if (evicted(cur->id_)) {
+                rejoin(cur->id_, cur->rd_ = wt_.load(std::memory_order_acquire));
+            }
+            // or dropped while being acquired, the next acquire notices it by fr_
+        }
+    }
+
+    void release(cursor_t const * cur, pos_t pos) noexcept {
+        if (cur == nullptr) return;
+        auto* rec = rec_at(pos);
+        if (Ts == trans::broadcast) {
+            rec->vw_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        release(rec, pos, bit_of(*cur));
+    }
+};
+
+} // namespace circ
+} // namespace ipc
@@ -12,45 +12,114 @@
 namespace ipc {
 namespace circ {
 
-template <typename Policy, std::size_t DataSize, std::size_t AlignSize>
+// the policies tracking their readers in shm have a reader_max
+template <typename Policy, typename = void>
+struct tracks_readers : std::false_type {};
+
+template <typename Policy>
+struct tracks_readers<Policy, std::void_t<decltype(Policy::reader_max)>> : std::true_type {};
+
+/*
+ * Each element is aligned to ElemAlign, which is a cache line by default,
+ * so the producers & consumers working on the neighbouring elements wouldn't share a line,
+ * the read-counters & commit flags wouldn't be bounced by the writes of the next payload.
+ * ElemAlign = 1 packs the elements as they are.
+*/
+template <typename Policy, std::size_t DataSize, std::size_t AlignSize, std::size_t ElemAlign = cache_line_size>
 class elem_array : public ipc::circ::conn_head {
 public:
     using base_t   = ipc::circ::conn_head;
     using policy_t = Policy;
     using cursor_t = decltype(std::declval<policy_t>().cursor());
-    using elem_t   = typename policy_t::template elem_t<DataSize, AlignSize>;
+
+private:
+    using raw_elem_t = typename policy_t::template elem_t<DataSize, AlignSize>;
+
+public:
+    struct alignas((ipc::detail::max)(ElemAlign, alignof(raw_elem_t))) elem_t : raw_elem_t {};
 
     enum : std::size_t {
         head_size  = sizeof(base_t) + sizeof(policy_t),
         data_size  = DataSize,
-        elem_max   = (std::numeric_limits<uint_t<8>>::max)() + 1, // default is 255 + 1
-        elem_size  = sizeof(elem_t),
-        block_size = elem_size * elem_max
+        elem_size  = sizeof(elem_t)
     };
 
+    constexpr static std::size_t block_size(std::size_t elem_max) noexcept {
+        return elem_size * circ::elem_max_of(elem_max);
+    }
+
+    /*
+     * The elements are placed right after the head,
+     * so an elem_array must be allocated with size_of(elem_max) bytes.
+    */
+    constexpr static std::size_t size_of(std::size_t elem_max) noexcept {
+        return sizeof(elem_array) + block_size(elem_max);
+    }
+
 private:
     policy_t head_;
-    elem_t   block_[elem_max];
+
+    elem_t* block() noexcept {
+        static_assert(alignof(elem_array) % alignof(elem_t) == 0, "unaligned block");
+        return reinterpret_cast<elem_t*>(this + 1);
+    }
 
 public:
     cursor_t cursor() const noexcept {
         return head_.cursor();
     }
 
+    // a reader joins the ring, & starts from the returned cursor
+    cursor_t connect_reader() {
+        if constexpr (tracks_readers<policy_t>::value) {
+            return head_.connect(this, block());
+        }
+        else {
+            base_t::connect();
+            return cursor();
+        }
+    }
+
+    // a reader beyond the reader_max of the policy isn't registered, its connecting has failed
+    bool registered(cursor_t const & cur) const noexcept {
+        if constexpr (tracks_readers<policy_t>::value) {
+            return cur.id_ < policy_t::reader_max;
+        }
+        else return true;
+    }
+
+    void disconnect_reader(cursor_t cur) {
+        if constexpr (tracks_readers<policy_t>::value) {
+            head_.disconnect(this, cur);
+        }
+        else base_t::disconnect();
+    }
+
     template <typename F>
     bool push(F&& f) {
-        return head_.push(this, std::forward<F>(f), block_);
+        return head_.push(this, std::forward<F>(f), block());
     }
 
     template <typename F>
     bool force_push(F&& f) {
-        return head_.force_push(this, std::forward<F>(f), block_);
+        return head_.force_push(this, std::forward<F>(f), block());
     }
 
     template <typename F>
     bool pop(cursor_t* cur, F&& f) {
         if (cur == nullptr) return false;
-        return head_.pop(this, *cur, std::forward<F>(f), block_);
+        return head_.pop(this, *cur, std::forward<F>(f), block());
+    }
+
+    template <typename F>
+    std::size_t push_n(std::size_t n, F&& f) {
+        return head_.push_n(this, n, std::forward<F>(f), block());
+    }
+
+    template <typename F>
+    std::size_t pop_n(cursor_t* cur, std::size_t n, F&& f) {
+        if (cur == nullptr) return 0;
+        return head_.pop_n(this, *cur, n, std::forward<F>(f), block());
     }
 };
 
@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <new>
+#include <type_traits>
 
 #include "rw_lock.h"
 
@@ -16,26 +17,43 @@ enum {
     cache_line_size = 64
 };
 
-using u1_t = ipc::uint_t<8>;
 using u2_t = ipc::uint_t<32>;
 
-constexpr u1_t index_of(u2_t c) noexcept {
-    return static_cast<u1_t>(c);
+enum : u2_t {
+    elem_max_min = 2,
+    elem_max_lim = 1u << 24
+};
+
+/*
+ * The ring capacity must be a power of 2 (cursors are masked, not truncated),
+ * so the requested value is rounded up & clamped to [elem_max_min, elem_max_lim].
+*/
+constexpr u2_t elem_max_of(std::size_t n) noexcept {
+    u2_t r = elem_max_min;
+    while ((r < n) && (r < elem_max_lim)) r <<= 1;
+    return r;
 }
 
+/*
+ * The read-mostly words (elem_max_ is read by every index_of) are kept apart from cc_,
+ * which is written by connecting & disconnecting.
+ * The policy heads following it align their cursors to cache lines too.
+*/
 class conn_head {
-    std::atomic<std::size_t> cc_ { 0 }; // connection counter
-
     ipc::spin_lock lc_;
     std::atomic<bool> constructed_;
+    u2_t elem_max_;                     // ring capacity, a power of 2
+
+    alignas(cache_line_size) std::atomic<std::size_t> cc_ { 0 }; // connection counter
 
 public:
-    void init() {
+    void init(std::size_t elem_max) {
         /* DCLP */
         if (!constructed_.load(std::memory_order_acquire)) {
             IPC_UNUSED_ auto guard = ipc::detail::unique_lock(lc_);
             if (!constructed_.load(std::memory_order_relaxed)) {
                 ::new (this) conn_head;
+                elem_max_ = elem_max_of(elem_max);
                 constructed_.store(true, std::memory_order_release);
             }
         }
@@ -56,6 +74,116 @@ public:
     std::size_t conn_count(std::memory_order order = std::memory_order_acquire) const noexcept {
         return cc_.load(order);
     }
+
+    u2_t elem_max() const noexcept {
+        return elem_max_;
+    }
+
+    u2_t index_of(u2_t c) const noexcept {
+        return c & (elem_max_ - 1);
+    }
+};
+
+/*
+ * The registry of the broadcast readers which could be evicted one by one.
+ * Each reader owns a bit, & each element records the bits of the readers which still have to read it.
+ * The low half of bits_ is the live readers, & the high half is the evicted ones,
+ * an evicted bit couldn't be claimed again until its reader has noticed the eviction.
+ *
+ * A bit isn't cleared from the ring when its reader leaves, since that would take a scan of the ring,
+ * from_ tells the position each reader reads from, & its bit on an element before that is stale.
+ * P is the position type, which is compared with wrapping.
+*/
+template <typename P>
+class reader_bits {
+public:
+    using mask_t = std::uint32_t;
+
+    enum : u2_t {
+        reader_max = 32
+    };
+
+protected:
+    alignas(cache_line_size) std::atomic<std::uint64_t> bits_;
+    std::atomic<P> from_[reader_max];
+
+    constexpr static std::uint64_t bit_of(u2_t id) noexcept {
+        return static_cast<std::uint64_t>(1) << id;
+    }
+
+    constexpr static bool before(P a, P b) noexcept {
+        return static_cast<std::make_signed_t<P>>(a - b) < 0;
+    }
+
+    mask_t live() const noexcept {
+        return static_cast<mask_t>(bits_.load(std::memory_order_acquire));
+    }
+
+    bool evicted(u2_t id) const noexcept {
+        return (bits_.load(std::memory_order_acquire) & (bit_of(id) << 32)) != 0;
+    }
+
+    // the live readers of the mask which still have to read the element at pos
+    mask_t lagging(mask_t mask, P pos) const noexcept {
+        auto lag = mask & live();
+        for (u2_t i = 0; (i < reader_max) && ((lag >> i) != 0); ++i) {
+            if (((lag >> i) & 1) && before(pos, from_[i].load(std::memory_order_relaxed))) {
+                lag &= ~static_cast<mask_t>(bit_of(i)); // stale
+            }
+        }
+        return lag;
+    }
+
+    // moves the live ones of the bits to the evicted half, returns the moved ones
+    mask_t evict(mask_t bits) noexcept {
+        auto cur = bits_.load(std::memory_order_acquire);
+        mask_t hit;
+        do {
+            if ((hit = static_cast<mask_t>(cur) & bits) == 0) return 0;
+        } while (!bits_.compare_exchange_weak(cur, (cur & ~static_cast<std::uint64_t>(hit)) |
+                                                   (static_cast<std::uint64_t>(hit) << 32),
+                                              std::memory_order_acq_rel));
+        return hit;
+    }
+
+    /*
+     * An evicted (or a new) reader takes its bit back, & reads from pos.
+     * from_ is published with the bit, so the producers wouldn't count its stale bits.
+     * Returns false if the bit wasn't an evicted one.
+    */
+    bool rejoin(u2_t id, P pos) noexcept {
+        auto bit = bit_of(id);
+        from_[id].store(pos, std::memory_order_relaxed);
+        auto cur = bits_.load(std::memory_order_relaxed);
+        while ((cur & (bit << 32)) &&
+               !bits_.compare_exchange_weak(cur, (cur & ~(bit << 32)) | bit, std::memory_order_acq_rel)) ;
+        return (cur & (bit << 32)) != 0;
+    }
+
+    // a reader which has read everything before pos could move its from_ there
+    void advance(u2_t id, P pos) noexcept {
+        from_[id].store(pos, std::memory_order_relaxed);
+    }
+
+    // claims a free bit as an evicted one, which would be rejoined, reader_max if there isn't any
+    u2_t claim_id() noexcept {
+        auto cur = bits_.load(std::memory_order_acquire);
+        for (u2_t i = 0; i < reader_max; ++i) {
+            auto bit = bit_of(i);
+            if ((cur & bit) || (cur & (bit << 32))) continue;
+            if (bits_.compare_exchange_strong(cur, cur | (bit << 32), std::memory_order_acq_rel)) {
+                return i;
+            }
+            i = static_cast<u2_t>(-1); // retry from the first bit
+        }
+        return reader_max;
+    }
+
+    // frees the bit, returns true if it was live
+    bool leave(u2_t id) noexcept {
+        auto bit = bit_of(id);
+        return (bits_.fetch_and(~(bit | (bit << 32)), std::memory_order_acq_rel) & bit) != 0;
+    }
 };
 
 } // namespace circ
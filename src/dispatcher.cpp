@@ -0,0 +1,250 @@
+#include "dispatcher.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+
+#include "pimpl.h"
+#include "log.h"
+#include "rw_lock.h"
+#include "mpsc_queue.h"
+
+#include "platform/affinity.h"
+
+namespace ipc {
+
+class dispatcher::dispatcher_ : public pimpl<dispatcher_> {
+public:
+    struct chan_t {
+        handle_t h_;
+        std::vector<buff_t> (*recv_batch_)(handle_t, std::size_t, std::size_t);
+        handler_t   fn_;
+        std::size_t worker_;
+    };
+
+    struct batch_t {
+        chan_t*             chan_ = nullptr;
+        std::vector<buff_t> buffs_;
+    };
+
+    struct worker_t {
+        mpsc_queue<batch_t>     que_;
+        std::thread             trd_;
+        std::mutex              lock_;
+        std::condition_variable cond_;
+        std::atomic<bool>       waiting_ { false };
+    };
+
+    enum : std::size_t {
+        quit_check = 100 // ms, the receiver checks for stopping at least this often
+    };
+
+    std::size_t const batch_;
+    bool        const pin_;
+
+    std::vector<std::unique_ptr<chan_t>>   chans_;
+    std::vector<std::unique_ptr<worker_t>> workers_;
+    std::unordered_map<handle_t, chan_t*>  handles_;
+    poller                                 poller_;
+    std::thread                            receiver_;
+    bool                                   running_ = false;
+
+    std::atomic<bool>          quit_       { false }; // the receiver
+    std::atomic<bool>          done_       { false }; // the workers, after the receiver has quit
+    std::atomic<wait_strategy> wait_       { wait_strategy::adaptive };
+    std::atomic<std::size_t>   dispatched_ { 0 };
+
+    dispatcher_(std::size_t workers, std::size_t batch, bool pin)
+        : batch_((batch == 0) ? 1 : batch)
+        , pin_  (pin) {
+        if (workers == 0) workers = 1;
+        for (std::size_t i = 0; i < workers; ++i) {
+            workers_.emplace_back(new worker_t);
+        }
+    }
+
+    void hand_off(chan_t* c, std::vector<buff_t>&& buffs) {
+        auto& w = *workers_[c->worker_];
+        w.que_.push({ c, std::move(buffs) });
+        // pairs with the fence in park
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (w.waiting_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard { w.lock_ };
+            w.cond_.notify_one();
+        }
+    }
+
+    /*
+     * A channel whose batch was full is tried again in the next turn without waiting,
+     * so a busy channel can't starve the others.
+    */
+    void receive() {
+        std::vector<chan_t*> ready, busy;
+        while (!quit_.load(std::memory_order_acquire)) {
+            ready.swap(busy);
+            busy.clear();
+            for (auto h : poller_.wait(ready.empty() ? std::size_t { quit_check } : 0)) {
+                auto c = handles_[h];
+                if (std::find(ready.begin(), ready.end(), c) == ready.end()) ready.push_back(c);
+            }
+            for (auto c : ready) {
+                // with tm 0 it never waits, a channel signaled for nothing costs one check
+                auto buffs = c->recv_batch_(c->h_, batch_, 0);
+                if (buffs.empty()) continue;
+                if (buffs.size() >= batch_) busy.push_back(c);
+                hand_off(c, std::move(buffs));
+            }
+            ready.clear();
+        }
+    }
+
+    void park(worker_t& w) {
+        std::unique_lock<std::mutex> guard { w.lock_ };
+        w.waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (w.que_.empty() && !done_.load(std::memory_order_acquire)) {
+            w.cond_.wait(guard);
+        }
+        w.waiting_.store(false, std::memory_order_relaxed);
+    }
+
+    void work(worker_t& w) {
+        batch_t batch;
+        unsigned k = 0;
+        for (;;) {
+            if (w.que_.pop(batch)) {
+                for (auto& buff : batch.buffs_) batch.chan_->fn_(std::move(buff));
+                dispatched_.fetch_add(batch.buffs_.size(), std::memory_order_relaxed);
+                batch.buffs_.clear();
+                k = 0;
+                continue;
+            }
+            // the receiver has quit, so nothing would be pushed any more
+            if (done_.load(std::memory_order_acquire) && w.que_.empty()) break;
+            switch (wait_.load(std::memory_order_relaxed)) {
+            case wait_strategy::spin:
+                break;
+            case wait_strategy::pause:
+                ipc::pause();
+                break;
+            case wait_strategy::block:
+                park(w);
+                break;
+            default:
+                ipc::sleep(k, [this, &w] {
+                    park(w);
+                    return true;
+                });
+                break;
+            }
+        }
+    }
+};
+
+dispatcher::dispatcher(std::size_t workers, std::size_t batch, bool pin)
+    : p_(p_->make(workers, batch, pin)) {
+}
+
+dispatcher::dispatcher(dispatcher&& rhs)
+    : dispatcher() {
+    swap(rhs);
+}
+
+dispatcher::~dispatcher() {
+    stop();
+    p_->clear();
+}
+
+void dispatcher::swap(dispatcher& rhs) {
+    std::swap(p_, rhs.p_);
+}
+
+dispatcher& dispatcher::operator=(dispatcher rhs) {
+    swap(rhs);
+    return *this;
+}
+
+bool dispatcher::add(handle_t h, int fd, bool (*arm)(handle_t),
+                     std::vector<buff_t> (*recv_batch)(handle_t, std::size_t, std::size_t), handler_t fn) {
+    auto p = impl(p_);
+    if (p->running_) {
+        ipc::error("fail: dispatcher add(%p), it's running\n", h);
+        return false;
+    }
+    if (!fn) {
+        ipc::error("fail: dispatcher add(%p), the handler is empty\n", h);
+        return false;
+    }
+    if (p->handles_.find(h) != p->handles_.end()) {
+        ipc::error("fail: dispatcher add(%p), added already\n", h);
+        return false;
+    }
+    if (!p->poller_.add(h, fd, arm)) {
+        return false;
+    }
+    auto worker = p->chans_.size() % p->workers_.size();
+    p->chans_.emplace_back(new dispatcher_::chan_t { h, recv_batch, std::move(fn), worker });
+    p->handles_.emplace(h, p->chans_.back().get());
+    return true;
+}
+
+void dispatcher::set_wait(wait_strategy ws) {
+    impl(p_)->wait_.store(ws, std::memory_order_relaxed);
+}
+
+bool dispatcher::start() {
+    auto p = impl(p_);
+    if (p->running_) return true;
+    if (p->chans_.empty()) {
+        ipc::error("fail: dispatcher start, no channel\n");
+        return false;
+    }
+    p->quit_.store(false, std::memory_order_relaxed);
+    p->done_.store(false, std::memory_order_relaxed);
+    std::size_t cpus = (std::max)(std::thread::hardware_concurrency(), 1u);
+    for (std::size_t i = 0; i < p->workers_.size(); ++i) {
+        auto& w = *p->workers_[i];
+        w.trd_ = std::thread { [p, &w] { p->work(w); } };
+        if (p->pin_) detail::pin_thread(w.trd_, (i + 1) % cpus);
+    }
+    p->receiver_ = std::thread { [p] { p->receive(); } };
+    if (p->pin_) detail::pin_thread(p->receiver_, 0);
+    p->running_ = true;
+    return true;
+}
+
+void dispatcher::stop() {
+    auto p = impl(p_);
+    if (!p->running_) return;
+    p->quit_.store(true, std::memory_order_release);
+    p->receiver_.join();
+    p->done_.store(true, std::memory_order_release);
+    for (auto& w : p->workers_) {
+        {
+            std::lock_guard<std::mutex> guard { w->lock_ };
+            w->cond_.notify_one();
+        }
+        w->trd_.join();
+    }
+    p->running_ = false;
+}
+
+bool dispatcher::running() const {
+    return impl(p_)->running_;
+}
+
+std::size_t dispatcher::size() const {
+    return impl(p_)->chans_.size();
+}
+
+std::size_t dispatcher::dispatched() const {
+    return impl(p_)->dispatched_.load(std::memory_order_relaxed);
+}
+
+} // namespace ipc
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+#include "def.h"
+
+namespace ipc {
+
+/*
+ * A free-list of ids in [0, Count), living in shared memory as it is (no pointers inside).
+ * It isn't thread-safe, the owner should guard it with a lock.
+*/
+template <std::size_t Count>
+class id_pool {
+    static_assert(Count > 0 && Count < (std::numeric_limits<uint_t<16>>::max)(),
+                  "Count must be in (0, 65535)");
+
+public:
+    enum : std::size_t {
+        max_count = Count
+    };
+
+private:
+    using id_t = uint_t<16>;
+
+    id_t cursor_ = 0;
+    id_t next_[max_count] {};
+    bool prepared_ = false;
+
+public:
+    // a zero-filled id_pool (e.g. a new shm segment) should be prepared at first
+    bool prepared() const noexcept {
+        return prepared_;
+    }
+
+    void prepare() noexcept {
+        for (std::size_t i = 0; i < max_count; ++i) {
+            next_[i] = static_cast<id_t>(i + 1);
+        }
+        cursor_   = 0;
+        prepared_ = true;
+    }
+
+    bool empty() const noexcept {
+        return cursor_ == max_count;
+    }
+
+    std::size_t acquire() noexcept {
+        if (empty()) return invalid_value;
+        std::size_t id = cursor_;
+        cursor_ = next_[id];
+        return id;
+    }
+
+    void release(std::size_t id) noexcept {
+        if (id >= max_count) return;
+        next_[id] = cursor_;
+        cursor_   = static_cast<id_t>(id);
+    }
+};
+
+} // namespace ipc
@@ -8,6 +8,9 @@
 #include <type_traits>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <climits>
 
 #include "def.h"
 #include "shm.h"
@@ -17,11 +20,13 @@
 #include "policy.h"
 #include "rw_lock.h"
 #include "log.h"
+#include "id_pool.h"
 
 #include "memory/resource.h"
 
 #include "platform/detail.h"
 #include "platform/waiter_wrapper.h"
+#include "platform/ready_fd.h"
 
 namespace {
 
@@ -31,11 +36,17 @@ using msg_id_t = std::size_t;
 template <std::size_t DataSize, std::size_t AlignSize>
 struct msg_t;
 
+enum : std::uint8_t {
+    msg_first   = 0x01, // the first fragment of a message
+    msg_storage = 0x02  // the data is an id of a shared chunk
+};
+
 template <std::size_t AlignSize>
 struct msg_t<0, AlignSize> {
-    void*    que_;
-    msg_id_t id_;
-    int      remain_;
+    void*        que_;
+    msg_id_t     id_;
+    int          remain_;
+    std::uint8_t flags_;
 };
 
 template <std::size_t DataSize, std::size_t AlignSize>
@@ -44,10 +55,11 @@ struct msg_t {
     std::aligned_storage_t<DataSize, AlignSize> data_ {};
 
     msg_t() = default;
-    msg_t(void* q, msg_id_t i, int r, void const * d, std::size_t s) {
+    msg_t(void* q, msg_id_t i, int r, void const * d, std::size_t s, std::uint8_t f = msg_first) {
         head_.que_    = q;
         head_.id_     = i;
         head_.remain_ = r;
+        head_.flags_  = f;
         std::memcpy(&data_, d, s);
     }
 };
@@ -60,12 +72,11 @@ buff_t make_cache(T& data, std::size_t size) {
 }
 
 struct cache_t {
-    std::size_t fill_;
-    buff_t      buff_;
-
-    cache_t(std::size_t f, buff_t&& b)
-        : fill_(f), buff_(std::move(b))
-    {}
+    void*         que_  = nullptr; // the sender, nullptr means the cache is free
+    msg_id_t      id_   = 0;
+    std::uint64_t seq_  = 0;       // the order of opening in its reassembly_t
+    std::size_t   fill_ = 0;
+    buff_t        buff_;
 
     void append(void const * data, std::size_t size) {
         if (fill_ >= buff_.size() || data == nullptr || size == 0) return;
@@ -73,43 +84,570 @@ struct cache_t {
         std::memcpy(static_cast<byte_t*>(buff_.data()) + fill_, data, new_fill - fill_);
         fill_ = new_fill;
     }
+
+    buff_t take() {
+        que_ = nullptr;
+        return std::move(buff_);
+    }
+};
+
+/*
+ * The partial messages of a receiving thread.
+ * A sender only has a few messages in flight, so the caches are indexed by the sender,
+ * and there is no allocation except the buffer of the whole message.
+ * When all caches are in use, the oldest message would be dropped.
+ * The caches are shared by the channels of the thread, whose message ids are counted apart,
+ * so the oldest is the first opened one.
+*/
+class reassembly_t {
+public:
+    enum : std::size_t {
+        max_count = 32
+    };
+
+private:
+    cache_t       caches_[max_count];
+    std::uint64_t seq_ = 0;
+
+    static std::size_t index_of(void* que) noexcept {
+        return (reinterpret_cast<std::uintptr_t>(que) / alignof(std::max_align_t)) % max_count;
+    }
+
+public:
+    cache_t* find(void* que, msg_id_t id) noexcept {
+        for (std::size_t k = 0, i = index_of(que); k < max_count; ++k, i = (i + 1) % max_count) {
+            auto& c = caches_[i];
+            if (c.que_ == que && c.id_ == id) return &c;
+        }
+        return nullptr;
+    }
+
+    cache_t& open(void* que, msg_id_t id, std::size_t fill, buff_t&& buff) {
+        cache_t* c = nullptr;
+        for (std::size_t k = 0, i = index_of(que); k < max_count; ++k, i = (i + 1) % max_count) {
+            if (caches_[i].que_ == nullptr) {
+                c = &caches_[i];
+                break;
+            }
+            if (c == nullptr || caches_[i].seq_ < c->seq_) {
+                c = &caches_[i];
+            }
+        }
+        c->que_  = que;
+        c->id_   = id;
+        c->seq_  = seq_++;
+        c->fill_ = fill;
+        c->buff_ = std::move(buff);
+        return *c;
+    }
+
+    // a message has been partly received
+    bool partial() const noexcept {
+        for (auto const & c : caches_) {
+            if (c.que_ != nullptr) return true;
+        }
+        return false;
+    }
+
+    // drops the partial messages
+    void clear() {
+        for (auto& c : caches_) c.take();
+    }
+};
+
+/*
+ * A large message is written into a shared chunk only once,
+ * and the ring carries the chunk id instead of the fragments.
+ * The chunk sizes are the powers of 2 from large_msg_align,
+ * and the chunks of the same size are gathered in one shm segment:
+ *
+ *  [chunk_info_t][chunk_t|data...][chunk_t|data...]...
+ *
+ * A chunk is referred to by the ring slot carrying its id, & by the buffers of its readers.
+ * The slot's reference goes when the slot is overwritten (or the unicast message is taken),
+ * & a reader takes its own one while copying the message out, before the slot could be overwritten.
+ * So the chunks of the messages nobody would read (their readers have left, been evicted or overrun,
+ * or a unicast one has been dropped) are given back as the ring goes on.
+ * On a broadcast ring the slots keep their chunks until the next lap,
+ * so a sender might fall back to the fragments while the ring holds large_msg_cache large messages.
+ * The last reference gives the chunk back to the id_pool, & the generation tells a stale id.
+*/
+struct alignas(std::max_align_t) chunk_t {
+    std::atomic<std::uint64_t> rc_; // [generation : slot's reference | readers' references]
+    std::uint32_t              id_;
+
+    constexpr static std::uint64_t slot_ref = 1ull << 31;
+
+    constexpr static std::uint32_t gen_of(std::uint64_t rc) noexcept {
+        return static_cast<std::uint32_t>(rc >> 32);
+    }
+
+    constexpr static std::uint32_t refs_of(std::uint64_t rc) noexcept {
+        return static_cast<std::uint32_t>(rc);
+    }
+
+    byte_t* data() noexcept {
+        return reinterpret_cast<byte_t*>(this + 1);
+    }
+};
+
+// the data of a message stored in a chunk
+struct chunk_ref_t {
+    std::uint32_t id_;
+    std::uint32_t gen_;
+};
+
+struct alignas(std::max_align_t) chunk_info_t {
+    ipc::id_pool<large_msg_cache> pool_;
+    ipc::spin_lock                lock_;
+
+    constexpr static std::size_t chunk_size(std::size_t size) noexcept {
+        std::size_t n = large_msg_align;
+        while (n < sizeof(chunk_t) + size) n <<= 1;
+        return n;
+    }
+
+    constexpr static std::size_t mem_size(std::size_t chunk_size) noexcept {
+        return sizeof(chunk_info_t) + chunk_size * large_msg_cache;
+    }
+
+    static chunk_info_t* info_of(chunk_t* c, std::size_t chunk_size) noexcept {
+        return reinterpret_cast<chunk_info_t*>(reinterpret_cast<byte_t*>(c) - chunk_size * c->id_) - 1;
+    }
+
+    chunk_t* at(std::size_t chunk_size, std::size_t id) noexcept {
+        return reinterpret_cast<chunk_t*>(reinterpret_cast<byte_t*>(this + 1) + chunk_size * id);
+    }
+};
+
+/*
+ * The segments are kept in the process until it exits,
+ * so the buffers referring to the chunks wouldn't outlive their memory.
+ * The readers only open them, as a torn copy of a message might tell a size never sent.
+*/
+chunk_info_t* chunk_storage(std::string const & prefix, std::size_t chunk_size, unsigned mode) {
+    static struct {
+        ipc::spin_lock lock_;
+        std::unordered_map<std::string, shm::handle> handles_;
+    } storages;
+    auto name = "__CHUNK_INFO__" + prefix + "__" + std::to_string(chunk_size);
+    IPC_UNUSED_ auto guard = ipc::detail::unique_lock(storages.lock_);
+    auto it = storages.handles_.find(name);
+    if (it == storages.handles_.end()) {
+        shm::handle h { name.c_str(), chunk_info_t::mem_size(chunk_size), mode };
+        if (!h.valid()) {
+            ipc::error("fail: chunk_storage, shm::handle(%s) is invalid\n", name.c_str());
+            return nullptr;
+        }
+        it = storages.handles_.emplace(std::move(name), std::move(h)).first;
+    }
+    return static_cast<chunk_info_t*>(it->second.get());
+}
+
+/*
+ * The segments a handle has opened, by the chunk size (log2 of it over large_msg_align),
+ * so only the first message of a chunk size looks them up in chunk_storage.
+*/
+class chunk_storages {
+    std::string   prefix_;
+    chunk_info_t* infos_[sizeof(std::size_t) * CHAR_BIT] {};
+
+public:
+    explicit chunk_storages(char const * prefix)
+        : prefix_(prefix) {
+    }
+
+    chunk_info_t* get(std::size_t chunk_size, unsigned mode) {
+        std::size_t k = 0;
+        while ((std::size_t(large_msg_align) << k) < chunk_size) ++k;
+        if (infos_[k] == nullptr) {
+            infos_[k] = chunk_storage(prefix_, chunk_size, mode);
+        }
+        return infos_[k];
+    }
+};
+
+// the chunk starts with the slot's reference only
+chunk_t* acquire_storage(chunk_storages& storages, std::size_t size) {
+    auto chunk_size = chunk_info_t::chunk_size(size);
+    auto info = storages.get(chunk_size, shm::create | shm::open);
+    if (info == nullptr) return nullptr;
+    std::size_t id;
+    {
+        IPC_UNUSED_ auto guard = ipc::detail::unique_lock(info->lock_);
+        if (!info->pool_.prepared()) {
+            info->pool_.prepare();
+            // a new segment, the rings might still carry the ids of the last one
+            auto gen = static_cast<std::uint32_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+            for (std::size_t i = 0; i < large_msg_cache; ++i) {
+                info->at(chunk_size, i)->rc_.store(static_cast<std::uint64_t>(gen) << 32, std::memory_order_relaxed);
+            }
+        }
+        id = info->pool_.acquire();
+    }
+    if (id == invalid_value) {
+        return nullptr; // all chunks are in use
+    }
+    auto c = info->at(chunk_size, id);
+    c->id_ = static_cast<std::uint32_t>(id);
+    auto gen = chunk_t::gen_of(c->rc_.load(std::memory_order_relaxed)) + 1;
+    c->rc_.store((static_cast<std::uint64_t>(gen) << 32) | chunk_t::slot_ref, std::memory_order_release);
+    return c;
+}
+
+chunk_t* find_storage(chunk_storages& storages, std::size_t size, std::size_t id) {
+    if ((id >= large_msg_cache) || (size <= large_msg_limit)) return nullptr;
+    auto chunk_size = chunk_info_t::chunk_size(size);
+    auto info = storages.get(chunk_size, shm::open);
+    return (info == nullptr) ? nullptr : info->at(chunk_size, id);
+}
+
+void free_storage(chunk_t* c, std::size_t size) {
+    auto info = chunk_info_t::info_of(c, chunk_info_t::chunk_size(size));
+    IPC_UNUSED_ auto guard = ipc::detail::unique_lock(info->lock_);
+    info->pool_.release(c->id_);
+}
+
+// a reader takes a reference, if the message is still in its slot
+bool take_storage(chunk_t* c, std::uint32_t gen) {
+    auto rc = c->rc_.load(std::memory_order_acquire);
+    do {
+        if ((chunk_t::gen_of(rc) != gen) || !(rc & chunk_t::slot_ref)) return false;
+    } while (!c->rc_.compare_exchange_weak(rc, rc + 1, std::memory_order_acq_rel));
+    return true;
+}
+
+void release_storage(chunk_t* c, std::size_t size) {
+    if (c == nullptr) return;
+    if (chunk_t::refs_of(c->rc_.fetch_sub(1, std::memory_order_acq_rel)) == 1) {
+        free_storage(c, size);
+    }
+}
+
+// the slot's reference goes only once, by the one who has overwritten or taken the message
+void drop_storage(chunk_t* c, std::uint32_t gen, std::size_t size) {
+    auto rc = c->rc_.load(std::memory_order_acquire);
+    do {
+        if ((chunk_t::gen_of(rc) != gen) || !(rc & chunk_t::slot_ref)) return;
+    } while (!c->rc_.compare_exchange_weak(rc, rc & ~chunk_t::slot_ref, std::memory_order_acq_rel));
+    if (chunk_t::refs_of(rc & ~chunk_t::slot_ref) == 0) {
+        free_storage(c, size);
+    }
+}
+
+// the reference a reader has taken while copying a message out
+class chunk_hold {
+    chunk_t*    c_    = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    chunk_hold() = default;
+    chunk_hold(const chunk_hold&) = delete;
+    chunk_hold& operator=(const chunk_hold&) = delete;
+
+    ~chunk_hold() {
+        reset();
+    }
+
+    chunk_t* get() const noexcept {
+        return c_;
+    }
+
+    void reset(chunk_t* c = nullptr, std::size_t size = 0) {
+        release_storage(c_, size_);
+        c_    = c;
+        size_ = size;
+    }
+
+    chunk_t* release() noexcept {
+        auto c = c_;
+        c_ = nullptr;
+        return c;
+    }
+};
+
+/*
+ * Tunes the spin budget (the yields before blocking) of the adaptive waits online.
+ * A wait ended after k yields moves the budget towards 2k;
+ * a parked one doubles it if the ring got ready within the spinning time after parking,
+ * or halves it if not (or it timed out).
+ * So a busy ring is spun on, & an idle one is parked on soon.
+ * The counters are relaxed atomics, as stats() might be read by another thread while waiting.
+*/
+class wait_tuner {
+public:
+    enum : unsigned {
+        spin_min  = 16,
+        spin_init = 4096, // as ipc::sleep
+        spin_max  = 65536
+    };
+
+private:
+    std::atomic<std::uint64_t> waits_   { 0 };
+    std::atomic<std::uint64_t> spun_    { 0 };
+    std::atomic<std::uint64_t> parked_  { 0 };
+    std::atomic<std::uint64_t> wait_ns_ { 0 };
+    std::atomic<unsigned>      budget_  { spin_init };
+
+    void count(std::atomic<std::uint64_t>& end, std::uint64_t ns) noexcept {
+        waits_  .fetch_add(1 , std::memory_order_relaxed);
+        end     .fetch_add(1 , std::memory_order_relaxed);
+        wait_ns_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+public:
+    unsigned budget() const noexcept {
+        return budget_.load(std::memory_order_relaxed);
+    }
+
+    void spun(unsigned k, std::uint64_t ns) noexcept {
+        count(spun_, ns);
+        auto target = (ipc::detail::max)(static_cast<unsigned>(spin_min), k * 2);
+        budget_.store((ipc::detail::min)(static_cast<unsigned>(spin_max), (budget() * 7 + target) / 8),
+                      std::memory_order_relaxed);
+    }
+
+    void parked(std::uint64_t spin_ns, std::uint64_t ns, bool ready) noexcept {
+        count(parked_, ns);
+        budget_.store((ready && (ns < spin_ns * 2)) ? (ipc::detail::min)(static_cast<unsigned>(spin_max), budget() * 2)
+                                                    : (ipc::detail::max)(static_cast<unsigned>(spin_min), budget() / 2),
+                      std::memory_order_relaxed);
+    }
+
+    wait_stats stats() const noexcept {
+        wait_stats ret;
+        ret.waits       = waits_  .load(std::memory_order_relaxed);
+        ret.spun        = spun_   .load(std::memory_order_relaxed);
+        ret.parked      = parked_ .load(std::memory_order_relaxed);
+        ret.wait_ns     = wait_ns_.load(std::memory_order_relaxed);
+        ret.spin_budget = budget();
+        return ret;
+    }
+};
+
+/*
+ * The receivers of a channel waiting on their readiness descriptors,
+ * a receiver takes a slot at the first ready_fd(), & sets its bit of armed_ in arm().
+ * The bits of a receiver dying with its slot stay set, but its address is released with its socket,
+ * so the slot could be taken again (see conn_info_head::ready_fd).
+*/
+struct alignas(circ::cache_line_size) ready_table_t {
+    constexpr static std::size_t slot_max = sizeof(std::uint64_t) * CHAR_BIT;
+
+    std::atomic<std::uint64_t> slots_;
+    std::atomic<std::uint64_t> armed_;
 };
 
 struct conn_info_head {
     using acc_t = std::atomic<msg_id_t>;
 
-    waiter      cc_waiter_, wt_waiter_, rd_waiter_;
-    shm::handle acc_h_;
+    std::string    prefix_;
+    waiter         cc_waiter_, wt_waiter_, rd_waiter_;
+    shm::handle    acc_h_, ready_h_;
+    chunk_storages chunks_;
+    overflow      overflow_ = overflow::wait;
+    wait_strategy wait_     = wait_strategy::adaptive;
+    wait_tuner    rd_tuner_, wt_tuner_; // the waits of recv & send
+
+    // the message loaned by loan(), a handle holds one at most
+    void*         loan_      = nullptr;
+    std::size_t   loan_size_ = 0;
+    std::uint64_t loan_pos_  = 0;
+
+    // the readiness descriptor of a receiver, & the signal of a sender
+    std::uint64_t        ready_key_; // the key of prefix_ + "__", see detail::ready_key
+    std::size_t          ready_id_ = invalid_value;
+    detail::ready_fd     ready_fd_;
+    detail::ready_signal ready_sig_;
 
     conn_info_head(char const * name)
-        : cc_waiter_((std::string{ "__CC_CONN__" } + name).c_str())
+        : prefix_   (name)
+        , cc_waiter_((std::string{ "__CC_CONN__" } + name).c_str())
         , wt_waiter_((std::string{ "__WT_CONN__" } + name).c_str())
         , rd_waiter_((std::string{ "__RD_CONN__" } + name).c_str())
-        , acc_h_    ((std::string{ "__AC_CONN__" } + name).c_str(), sizeof(acc_t)) {
+        , acc_h_    ((std::string{ "__AC_CONN__" } + name).c_str(), sizeof(acc_t))
+        , ready_h_  ((std::string{ "__RD_READY__" } + name).c_str(), sizeof(ready_table_t))
+        , chunks_   (name) {
+        ready_key_ = detail::ready_key("__", 2, detail::ready_key(prefix_.data(), prefix_.size()));
+    }
+
+    ~conn_info_head() {
+        if (ready_id_ == invalid_value) return;
+        auto bit = ~(std::uint64_t(1) << ready_id_);
+        ready()->armed_.fetch_and(bit, std::memory_order_acq_rel);
+        ready()->slots_.fetch_and(bit, std::memory_order_acq_rel);
     }
 
     auto acc() {
         return static_cast<acc_t*>(acc_h_.get());
     }
+
+    ready_table_t* ready() {
+        return static_cast<ready_table_t*>(ready_h_.get());
+    }
+
+    // the key of the slot's address (the name is prefix_ + "__" + id), with no string built
+    std::uint64_t ready_key(std::size_t id) const noexcept {
+        char buf[4];
+        std::size_t n = 0;
+        if (id >= 10) buf[n++] = static_cast<char>('0' + id / 10);
+        buf[n++] = static_cast<char>('0' + id % 10);
+        return detail::ready_key(buf, n, ready_key_);
+    }
+
+    /*
+     * Binding the slot's address decides who takes it, so the receivers never share one.
+     * The free slots are tried first, then the ones left by the receivers which died without releasing them.
+    */
+    int ready_fd() {
+        if (ready_id_ != invalid_value) return ready_fd_.fd();
+        auto table = ready();
+        if (table == nullptr) return -1;
+        auto slots = table->slots_.load(std::memory_order_acquire);
+        for (std::uint64_t used : { 0, 1 }) {
+            for (std::size_t id = 0; id < ready_table_t::slot_max; ++id) {
+                if (((slots >> id) & 1) != used) continue;
+                if (!ready_fd_.open(ready_key(id))) continue;
+                auto bit = std::uint64_t(1) << id;
+                table->armed_.fetch_and(~bit, std::memory_order_acq_rel);
+                table->slots_.fetch_or (bit, std::memory_order_acq_rel);
+                ready_id_ = id;
+                return ready_fd_.fd();
+            }
+        }
+        ipc::error("fail: ready_fd(%s), all the slots are in use\n", prefix_.c_str());
+        return -1;
+    }
+
+    bool arm() {
+        if (ready_id_ == invalid_value) return false;
+        ready_fd_.drain();
+        ready()->armed_.fetch_or(std::uint64_t(1) << ready_id_, std::memory_order_seq_cst);
+        return true;
+    }
+
+    /*
+     * Wakes the receivers blocked in recv, & signals the armed readiness descriptors once.
+     * The broadcast has fenced (seq_cst) before the load of armed_.
+    */
+    void wake_readers() {
+        rd_waiter_.broadcast();
+        auto table = ready();
+        if ((table == nullptr) || (table->armed_.load(std::memory_order_relaxed) == 0)) return;
+        auto armed = table->armed_.exchange(0, std::memory_order_acq_rel);
+        for (std::size_t id = 0; armed != 0; ++id, armed >>= 1) {
+            if (armed & 1) ready_sig_.signal(ready_key(id));
+        }
+    }
 };
 
+/*
+ * Polls pred until it returns false, or tm (ms) is over.
+ * The clock is only read once per spin_check tries.
+*/
+template <typename F>
+bool spin_for(F&& pred, std::size_t tm, bool pausing) {
+    constexpr unsigned spin_check = 64;
+    if (!pred()) return true;
+    if (tm == 0) return false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(tm);
+    for (unsigned k = 1; pred(); ++k) {
+        if (pausing && (k > 4)) ipc::pause();
+        if ((tm != invalid_value) && (k % spin_check == 0) && (std::chrono::steady_clock::now() >= deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * One deadline is taken at the entry, so tm bounds the whole wait:
+ * the spinning checks it, & each blocking wait is given what is left of it.
+*/
 template <typename W, typename F>
-bool wait_for(W& waiter, F&& pred, std::size_t tm) {
-    for (unsigned k = 0; pred();) {
-        bool loop = true, ret = true;
-        ipc::sleep(k, [&k, &loop, &ret, &waiter, &pred, tm] {
-            ret = waiter.wait_if([&loop, &pred] {
+bool wait_for(W& waiter, F&& pred, std::size_t tm,
+              wait_strategy ws = wait_strategy::adaptive, wait_tuner* tuner = nullptr) {
+    if (!pred()) return true;
+    if (tm == 0) return false; // a poll checks once, whatever the strategy is
+    if ((ws == wait_strategy::spin) || (ws == wait_strategy::pause)) {
+        return spin_for(pred, tm, ws == wait_strategy::pause);
+    }
+    using clock_t = std::chrono::steady_clock;
+    auto const deadline = clock_t::now() + std::chrono::milliseconds((tm == invalid_value) ? 0 : tm);
+    // the ms left, rounded up, 0 if it's over
+    auto remain = [tm, deadline]() -> std::size_t {
+        if (tm == invalid_value) return invalid_value;
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock_t::now()).count();
+        return (left <= 0) ? 0 : static_cast<std::size_t>((left + 999) / 1000);
+    };
+    if (ws == wait_strategy::block) {
+        for (bool loop = pred(); loop;) {
+            auto left = remain();
+            if ((left == 0) || !waiter.wait_if([&loop, &pred] {
                 return loop = pred();
-            }, tm);
-            k = 0;
-            return true;
-        });
-        if (!ret ) return false; // timeout or fail
-        if (!loop) break;
+            }, left)) return false; // timeout or fail
+        }
+        return true;
+    }
+    constexpr unsigned spin_check = 16;
+    auto const budget = (tuner == nullptr) ? static_cast<unsigned>(wait_tuner::spin_init) : tuner->budget();
+    auto ns_since = [](clock_t::time_point tp) {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - tp).count());
+    };
+    clock_t::time_point start, park;
+    if (tuner != nullptr) start = clock_t::now();
+    bool parked = false;
+    unsigned k = 0;
+    for (bool loop = true; loop;) {
+        std::size_t left = invalid_value;
+        if (k < budget) {
+            if ((k % spin_check != 0) || ((left = remain()) != 0)) {
+                std::this_thread::yield();
+                ++k;
+                loop = pred();
+                continue;
+            }
+        }
+        else left = remain();
+        if (!parked && (tuner != nullptr)) park = clock_t::now();
+        parked = true;
+        if ((left == 0) || !waiter.wait_if([&loop, &pred] {
+            return loop = pred();
+        }, left)) {
+            // timeout or fail
+            if (tuner != nullptr) tuner->parked(0, ns_since(start), false);
+            return false;
+        }
+        k = 0;
+    }
+    if (tuner != nullptr) {
+        if (parked) tuner->parked(static_cast<std::uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(park - start).count()),
+                        ns_since(start), true);
+        else tuner->spun(k, ns_since(start));
     }
     return true;
 }
 
+/*
+ * Pushes a message by push(), & handles a full ring as the sender's overflow setting says,
+ * force() is the force_push of it.
+*/
+template <typename P, typename F>
+bool push_for(conn_info_head* info, P&& push, F&& force) {
+    if (info->overflow_ == overflow::drop) {
+        return push() || force();
+    }
+    if (push()) return true;
+    // the readers are woken once per message, the ones sleeping on the pushed fragments must drain them
+    info->wake_readers();
+    if (wait_for(info->wt_waiter_, [&push] { return !push(); }, default_timeut, info->wait_, &info->wt_tuner_)) {
+        return true;
+    }
+    return (info->overflow_ == overflow::wait) && force();
+}
+
 template <typename Policy, 
           std::size_t DataSize, 
           std::size_t AlignSize = (ipc::detail::min)(DataSize, alignof(std::max_align_t))>
@@ -120,20 +658,48 @@ struct queue_generator {
     struct conn_info_t : conn_info_head {
         queue_t que_;
 
-        conn_info_t(char const * name)
+        conn_info_t(char const * name, std::size_t elem_max)
             : conn_info_head(name)
             , que_(("__QU_CONN__" + 
                     std::to_string(DataSize ) + "__" + 
-                    std::to_string(AlignSize) + "__" + name).c_str()) {
+                    std::to_string(AlignSize) + "__" + name).c_str(), elem_max) {
         }
     };
 };
 
-template <typename Policy>
-struct detail_impl {
+template <typename Policy, std::size_t AlignSize>
+struct queue_generator<Policy, var_length, AlignSize> {
+
+    using queue_t = ipc::byte_queue<Policy>;
+
+    struct conn_info_t : conn_info_head {
+        queue_t que_;
+
+        conn_info_t(char const * name, std::size_t elem_max)
+            : conn_info_head(name)
+            , que_(("__QU_CONN__" + 
+                    std::to_string(var_length) + "__" + name).c_str(), elem_max) {
+        }
+    };
+};
+
+template <typename Flag>
+struct is_broadcast : std::false_type {};
+
+template <relat Rp, relat Rc>
+struct is_broadcast<wr<Rp, Rc, trans::broadcast>> : std::true_type {};
+
+template <>
+struct is_broadcast<wr_cursor> : std::true_type {};
+
+template <>
+struct is_broadcast<wr_lossy> : std::true_type {};
 
-using queue_t     = typename queue_generator<Policy, data_length>::queue_t;
-using conn_info_t = typename queue_generator<Policy, data_length>::conn_info_t;
+template <typename Policy, std::size_t DataSize>
+struct conn_impl {
+
+using queue_t     = typename queue_generator<Policy, DataSize>::queue_t;
+using conn_info_t = typename queue_generator<Policy, DataSize>::conn_info_t;
 
 constexpr static conn_info_t* info_of(ipc::handle_t h) {
     return static_cast<conn_info_t*>(h);
@@ -143,32 +709,28 @@ constexpr static queue_t* queue_of(ipc::handle_t h) {
     return (info_of(h) == nullptr) ? nullptr : &(info_of(h)->que_);
 }
 
-static auto& recv_cache() {
-    /*
-        <Remarks> thread_local may have some bugs.
-        See: https://sourceforge.net/p/mingw-w64/bugs/727/
-             https://sourceforge.net/p/mingw-w64/bugs/527/
-             https://github.com/Alexpux/MINGW-packages/issues/2519
-             https://github.com/ChaiScript/ChaiScript/issues/402
-             https://developercommunity.visualstudio.com/content/problem/124121/thread-local-variables-fail-to-be-initialized-when.html
-             https://software.intel.com/en-us/forums/intel-c-compiler/topic/684827
-    */
-    static tls::pointer<mem::unordered_map<msg_id_t, cache_t>> rc;
-    return *rc.create();
-}
-
 /* API implementations */
 
-static ipc::handle_t connect(char const * name, bool start) {
-    auto h = mem::alloc<conn_info_t>(name);
+static ipc::handle_t connect(char const * name, bool start, std::size_t elem_max) {
+    auto h = mem::alloc<conn_info_t>(name, elem_max);
     auto que = queue_of(h);
     if (que == nullptr) {
         return nullptr;
     }
+    // a unicast sender fails on a full ring by default, as forcing would drop the unread messages
+    if (!is_broadcast<typename Policy::wr_t>::value) {
+        info_of(h)->overflow_ = overflow::fail;
+    }
     if (start) {
-        if (que->connect()) { // wouldn't connect twice
-            info_of(h)->cc_waiter_.broadcast();
+        // a new handle wouldn't connect twice, so it fails only if the ring has no room for another reader
+        if (!que->connect()) {
+            ipc::error("fail: connect, %s couldn't take another receiver\n", name);
+            mem::free(info_of(h));
+            return nullptr;
         }
+        info_of(h)->cc_waiter_.broadcast();
+        // a sender waiting on a ring without any reader could go on now
+        info_of(h)->wt_waiter_.broadcast();
     }
     return h;
 }
@@ -192,6 +754,63 @@ static std::size_t recv_count(ipc::handle_t h) {
     return que->conn_count();
 }
 
+// a failed try_send would never succeed (rather than the ring being full) if this is false
+static bool sendable(ipc::handle_t h, std::size_t /*size*/) {
+    auto que = queue_of(h);
+    if ((que == nullptr) || !que->valid()) return false;
+    // a broadcast ring without any receiver takes no message
+    return !is_broadcast<typename Policy::wr_t>::value || (que->conn_count() != 0);
+}
+
+// the cursors of the policies which could overrun a reader count the skipped elements
+template <typename C>
+constexpr static auto lost_of(C const & cur, int) noexcept -> decltype(std::size_t(cur.lost_)) {
+    return cur.lost_;
+}
+
+template <typename C>
+constexpr static std::size_t lost_of(C const &, long) noexcept {
+    return 0;
+}
+
+template <typename C>
+constexpr static std::size_t lost_of(C const & cur) noexcept {
+    return lost_of(cur, 0);
+}
+
+static std::size_t lost_count(ipc::handle_t h) {
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        return 0;
+    }
+    return lost_of(que->cursor());
+}
+
+static void set_overflow(ipc::handle_t h, overflow ov) {
+    if (info_of(h) == nullptr) return;
+    info_of(h)->overflow_ = ov;
+}
+
+static void set_wait(ipc::handle_t h, wait_strategy ws) {
+    if (info_of(h) == nullptr) return;
+    info_of(h)->wait_ = ws;
+}
+
+static wait_stats stats(ipc::handle_t h, unsigned mode) {
+    if (info_of(h) == nullptr) return {};
+    return ((mode & receiver) ? info_of(h)->rd_tuner_ : info_of(h)->wt_tuner_).stats();
+}
+
+static int ready_fd(ipc::handle_t h) {
+    if (info_of(h) == nullptr) return -1;
+    return info_of(h)->ready_fd();
+}
+
+static bool arm(ipc::handle_t h) {
+    if (info_of(h) == nullptr) return false;
+    return info_of(h)->arm();
+}
+
 static bool wait_for_recv(ipc::handle_t h, std::size_t r_count, std::size_t tm) {
     auto que = queue_of(h);
     if (que == nullptr) {
@@ -199,12 +818,71 @@ static bool wait_for_recv(ipc::handle_t h, std::size_t r_count, std::size_t tm)
     }
     return wait_for(info_of(h)->cc_waiter_, [que, r_count] {
         return que->conn_count() < r_count;
-    }, tm);
+    }, tm, info_of(h)->wait_);
+}
+
+}; // conn_impl<Policy, DataSize>
+
+template <typename Policy, std::size_t DataSize>
+struct detail_impl : conn_impl<Policy, DataSize> {
+
+using base_t = conn_impl<Policy, DataSize>;
+using typename base_t::queue_t;
+using typename base_t::conn_info_t;
+using base_t::info_of;
+using base_t::queue_of;
+
+using value_t = typename queue_t::value_t;
+
+// msg.head_.remain_ may minus & abs(msg.head_.remain_) < DataSize
+constexpr static std::size_t size_of(value_t const & msg) noexcept {
+    return static_cast<std::size_t>(static_cast<int>(DataSize) + msg.head_.remain_);
+}
+
+// the chunk a large message is stored in, or nullptr
+static chunk_t* storage_of(conn_info_t* info, value_t const & msg, chunk_ref_t& ref) {
+    if (!(msg.head_.flags_ & msg_storage) || (msg.head_.remain_ <= 0)) return nullptr;
+    std::memcpy(&ref, &msg.data_, sizeof(ref));
+    return find_storage(info->chunks_, size_of(msg), ref.id_);
+}
+
+// a sender overwrites an old message, whose chunk loses the slot's reference
+static void recycle(conn_info_t* info, value_t const & old) {
+    chunk_ref_t ref;
+    auto c = storage_of(info, old, ref);
+    if (c != nullptr) drop_storage(c, ref.gen_, size_of(old));
+}
+
+// a receiver copying a large message out takes a reference on its chunk
+static void hold(conn_info_t* info, value_t const & msg, chunk_hold& hd) {
+    chunk_ref_t ref;
+    auto c = storage_of(info, msg, ref);
+    hd.reset(((c != nullptr) && take_storage(c, ref.gen_)) ? c : nullptr, size_of(msg));
+}
+
+static auto& recv_cache() {
+    /*
+        <Remarks> thread_local may have some bugs.
+        See: https://sourceforge.net/p/mingw-w64/bugs/727/
+             https://sourceforge.net/p/mingw-w64/bugs/527/
+             https://github.com/Alexpux/MINGW-packages/issues/2519
+             https://github.com/ChaiScript/ChaiScript/issues/402
+             https://developercommunity.visualstudio.com/content/problem/124121/thread-local-variables-fail-to-be-initialized-when.html
+             https://software.intel.com/en-us/forums/intel-c-compiler/topic/684827
+    */
+    static tls::pointer<reassembly_t> rc;
+    return *rc.create();
 }
 
+/*
+ * The message might be led by a header of hsize bytes (at most DataSize),
+ * which is gathered with the data fragment by fragment, so the two are never joined in a temporary buffer.
+ * The readers aren't woken if !wake, for the rings whose receivers wait elsewhere (see shard_impl).
+*/
 template <typename F>
-static bool send(F&& gen_push, ipc::handle_t h, void const * data, std::size_t size) {
-    if (data == nullptr || size == 0) {
+static bool send(F&& gen_push, ipc::handle_t h, void const * data, std::size_t size,
+                 void const * head = nullptr, std::size_t hsize = 0, bool wake = true) {
+    if (data == nullptr || size == 0 || hsize > DataSize) {
         ipc::error("fail: send(%p, %zd)\n", data, size);
         return false;
     }
@@ -221,176 +899,1539 @@ static bool send(F&& gen_push, ipc::handle_t h, void const * data, std::size_t s
     }
     auto msg_id   = acc->fetch_add(1, std::memory_order_relaxed);
     auto try_push = std::forward<F>(gen_push)(info_of(h), que, msg_id);
+    // the readers are woken once the whole message (or a part of it on failure) has been pushed
+    IPC_UNUSED_ auto guard = ipc::detail::unique_ptr(wake ? info_of(h) : nullptr, [](auto info) {
+        info->wake_readers();
+    });
+    auto total = hsize + size;
+    // store a large message in a shared chunk, or send the fragments if there is no free chunk
+    if (total > (ipc::detail::max)(static_cast<std::size_t>(DataSize), static_cast<std::size_t>(large_msg_limit))) {
+        auto c = acquire_storage(info_of(h)->chunks_, total);
+        if (c != nullptr) {
+            if (hsize != 0) std::memcpy(c->data(), head, hsize);
+            std::memcpy(static_cast<byte_t*>(c->data()) + hsize, data, size);
+            chunk_ref_t ref { c->id_, chunk_t::gen_of(c->rc_.load(std::memory_order_relaxed)) };
+            if (try_push(static_cast<int>(total) - static_cast<int>(DataSize), &ref, sizeof(ref), msg_first | msg_storage)) {
+                return true;
+            }
+            drop_storage(c, ref.gen_, total);
+            return false;
+        }
+    }
+    // the bytes [offset, offset + n) of the message, only the first fragment could take the header
+    byte_t first[DataSize];
+    auto piece = [&](std::size_t offset, std::size_t n) -> void const * {
+        if (offset >= hsize) return static_cast<byte_t const *>(data) + (offset - hsize);
+        std::memcpy(first, head, hsize);
+        std::memcpy(first + hsize, data, n - hsize);
+        return first;
+    };
     // push message fragment
     int offset = 0;
-    for (int i = 0; i < static_cast<int>(size / data_length); ++i, offset += data_length) {
-        if (!try_push(static_cast<int>(size) - offset - static_cast<int>(data_length),
-                      static_cast<byte_t const *>(data) + offset, data_length)) {
+    for (int i = 0; i < static_cast<int>(total / DataSize); ++i, offset += DataSize) {
+        if (!try_push(static_cast<int>(total) - offset - static_cast<int>(DataSize),
+                      piece(static_cast<std::size_t>(offset), DataSize), DataSize, (i == 0) ? msg_first : 0)) {
             return false;
         }
     }
     // if remain > 0, this is the last message fragment
-    int remain = static_cast<int>(size) - offset;
+    int remain = static_cast<int>(total) - offset;
     if (remain > 0) {
-        if (!try_push(remain - static_cast<int>(data_length),
-                      static_cast<byte_t const *>(data) + offset, static_cast<std::size_t>(remain))) {
+        if (!try_push(remain - static_cast<int>(DataSize),
+                      piece(static_cast<std::size_t>(offset), static_cast<std::size_t>(remain)), static_cast<std::size_t>(remain),
+                      (offset == 0) ? msg_first : 0)) {
             return false;
         }
     }
     return true;
 }
 
-static bool send(ipc::handle_t h, void const * data, std::size_t size) {
+static bool send(ipc::handle_t h, void const * data, std::size_t size,
+                 void const * head = nullptr, std::size_t hsize = 0, bool wake = true) {
     return send([](auto info, auto que, auto msg_id) {
-        return [info, que, msg_id](int remain, void const * data, std::size_t size) {
-            if (!wait_for(info->wt_waiter_, [&] {
-                    return !que->push(que, msg_id, remain, data, size);
-                }, default_timeut)) {
-                if (!que->force_push(que, msg_id, remain, data, size)) {
-                    return false;
-                }
-            }
-            info->rd_waiter_.broadcast();
-            return true;
+        return [info, que, msg_id](int remain, void const * data, std::size_t size, std::uint8_t flags) {
+            auto over = [info](value_t const & old) { recycle(info, old); };
+            return push_for(info, [&] { return que->push_over      (over, que, msg_id, remain, data, size, flags); },
+                                  [&] { return que->force_push_over(over, que, msg_id, remain, data, size, flags); });
         };
-    }, h, data, size);
+    }, h, data, size, head, hsize, wake);
 }
 
 static bool try_send(ipc::handle_t h, void const * data, std::size_t size) {
     return send([](auto info, auto que, auto msg_id) {
-        return [info, que, msg_id](int remain, void const * data, std::size_t size) {
-            if (!wait_for(info->wt_waiter_, [&] {
-                    return !que->push(que, msg_id, remain, data, size);
-                }, 0)) {
-                return false;
-            }
-            info->rd_waiter_.broadcast();
-            return true;
+        return [info, que, msg_id](int remain, void const * data, std::size_t size, std::uint8_t flags) {
+            return wait_for(info->wt_waiter_, [&] {
+                return !que->push_over([info](value_t const & old) { recycle(info, old); },
+                                       que, msg_id, remain, data, size, flags);
+            }, 0, info->wait_, &info->wt_tuner_);
         };
     }, h, data, size);
 }
 
-static buff_t recv(ipc::handle_t h, std::size_t tm) {
+/*
+ * The messages fit in one fragment are pushed with push_n,
+ * so a run of them takes one id update, one index update & one notification.
+ * The larger ones are sent one by one.
+*/
+static bool send_batch(ipc::handle_t h, buff_t const * msgs, std::size_t n) {
+    if (msgs == nullptr && n != 0) {
+        ipc::error("fail: send_batch(%p, %zd)\n", msgs, n);
+        return false;
+    }
     auto que = queue_of(h);
     if (que == nullptr) {
-        ipc::error("fail: recv, queue_of(h) == nullptr\n");
-        return {};
+        ipc::error("fail: send_batch, queue_of(h) == nullptr\n");
+        return false;
     }
-    if (que->connect()) { // wouldn't connect twice
-        info_of(h)->cc_waiter_.broadcast();
+    auto acc = info_of(h)->acc();
+    if (acc == nullptr) {
+        ipc::error("fail: send_batch, info_of(h)->acc() == nullptr\n");
+        return false;
     }
-    auto& rc = recv_cache();
+    auto info = info_of(h);
+    auto over = [info](value_t const & old) { recycle(info, old); };
+    for (std::size_t i = 0; i < n;) {
+        std::size_t j = i;
+        while ((j < n) && !msgs[j].empty() && (msgs[j].size() <= DataSize)) ++j;
+        if (j == i) {
+            if (!send(h, msgs[i].data(), msgs[i].size())) return false;
+            ++i;
+            continue;
+        }
+        auto msg_id = acc->fetch_add(j - i, std::memory_order_relaxed);
+        while (i < j) {
+            std::size_t count = 0;
+            if (!push_for(info, [&] {
+                    return (count = que->push_n(j - i, over, [&](std::size_t k) {
+                        auto const & m = msgs[i + k];
+                        return value_t {
+                            que, msg_id + k, static_cast<int>(m.size()) - static_cast<int>(DataSize), m.data(), m.size()
+                        };
+                    })) != 0;
+                }, [&] {
+                    auto const & m = msgs[i];
+                    count = 1;
+                    return que->force_push_over(over, que, msg_id, static_cast<int>(m.size()) - static_cast<int>(DataSize), m.data(), m.size());
+                })) {
+                info->wake_readers();
+                return false;
+            }
+            msg_id += count;
+            i      += count;
+        }
+        info->wake_readers();
+    }
+    return true;
+}
+
+/*
+ * A message couldn't be laid in the fixed-size slots as a whole,
+ * so the loaned buffer is a staging one, which would be sent by commit.
+*/
+static void* loan(ipc::handle_t h, std::size_t size) {
+    auto info = info_of(h);
+    if (info == nullptr || size == 0) {
+        ipc::error("fail: loan(%p, %zd)\n", h, size);
+        return nullptr;
+    }
+    if (info->loan_ != nullptr) {
+        ipc::error("fail: loan, the last loan hasn't been committed\n");
+        return nullptr;
+    }
+    info->loan_size_ = size;
+    return info->loan_ = mem::alloc(size);
+}
+
+static bool commit(ipc::handle_t h) {
+    auto info = info_of(h);
+    if (info == nullptr || info->loan_ == nullptr) {
+        ipc::error("fail: commit, nothing has been loaned\n");
+        return false;
+    }
+    auto ret = send(h, info->loan_, info->loan_size_);
+    mem::free(info->loan_, info->loan_size_);
+    info->loan_ = nullptr;
+    return ret;
+}
+
+static void disconnect(ipc::handle_t h) {
+    auto info = info_of(h);
+    if (info != nullptr && info->loan_ != nullptr) {
+        mem::free(info->loan_, info->loan_size_);
+    }
+    base_t::disconnect(h);
+}
+
+/*
+ * Handles a popped message fragment, with the reference taken on its chunk if it's a large one,
+ * returns true if there is a whole message (or an error, with an empty buff) to return.
+*/
+static bool deliver(queue_t* que, value_t& msg, chunk_hold& hd, buff_t& buff,
+                    reassembly_t& rc = recv_cache()) {
+    if (msg.head_.que_ == nullptr) {
+        ipc::error("fail: recv, msg.head_.que_ == nullptr\n");
+        return true;
+    }
+    auto remain = size_of(msg);
+    // a large message in a shared chunk, the buffer refers to the chunk directly
+    if (msg.head_.flags_ & msg_storage) {
+        auto c = hd.get();
+        if (c == nullptr) return false; // it has gone with its slot, drop it
+        if (!is_broadcast<typename Policy::wr_t>::value) {
+            // the unicast message has been taken, so the slot wouldn't refer to the chunk any more
+            chunk_ref_t ref;
+            std::memcpy(&ref, &msg.data_, sizeof(ref));
+            drop_storage(c, ref.gen_, remain);
+        }
+        if (msg.head_.que_ == que) return false; // pop next
+        buff = buff_t { c->data(), remain, [](void* p, std::size_t size) {
+            release_storage(static_cast<chunk_t*>(p), size);
+        }, hd.release() };
+        return true;
+    }
+    if (msg.head_.que_ == que) return false; // pop next
+    if (msg.head_.flags_ & msg_first) {
+        // a whole message in one fragment
+        if (msg.head_.remain_ <= 0) {
+            buff = make_cache(msg.data_, remain);
+            return true;
+        }
+        // cache the first message fragment, the buffer is sized for the whole message
+        rc.open(msg.head_.que_, msg.head_.id_, DataSize, make_cache(msg.data_, remain));
+        return false;
+    }
+    auto cac = rc.find(msg.head_.que_, msg.head_.id_);
+    if (cac == nullptr) return false; // the first fragment has been lost, drop it
+    if (cac->buff_.size() - remain != cac->fill_) {
+        cac->take(); // a fragment in the middle has been lost, drop the message
+        return false;
+    }
+    // this is the last message fragment
+    if (msg.head_.remain_ <= 0) {
+        cac->append(&(msg.data_), remain);
+        buff = cac->take();
+        return true;
+    }
+    // there are remain datas after this message
+    cac->append(&(msg.data_), DataSize);
+    return false;
+}
+
+static buff_t recv(ipc::handle_t h, std::size_t tm) {
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: recv, queue_of(h) == nullptr\n");
+        return {};
+    }
+    if (que->connect()) { // wouldn't connect twice
+        info_of(h)->cc_waiter_.broadcast();
+    }
+    auto info  = info_of(h);
+    bool freed = false; // fragments have been popped since the writers were woken
+    auto wake  = [info, &freed] {
+        if (freed) info->wt_waiter_.broadcast();
+        freed = false;
+    };
     while (1) {
         // pop a new message
-        typename queue_t::value_t msg;
-        if (!wait_for(info_of(h)->rd_waiter_,
-                      [que, &msg] { return !que->pop(msg); }, tm)) {
+        // an evicted receiver goes on from the newest message, lost_count tells the skipped count
+        value_t    msg;
+        chunk_hold hd;
+        if (!wait_for(info->rd_waiter_, [info, que, &msg, &hd, &wake] {
+                if (que->pop(msg, [info, &hd](value_t const & m) { hold(info, m, hd); })) return false;
+                // a writer blocked by a full ring waits for the popped slots
+                wake();
+                return true;
+            }, tm, info->wait_, &info->rd_tuner_)) {
+            return {};
+        }
+        freed = true;
+        buff_t buff;
+        if (deliver(que, msg, hd, buff)) {
+            wake();
+            return buff;
+        }
+    }
+}
+
+// fragments popped at once by recv_batch
+constexpr static std::size_t batch_count =
+    (ipc::detail::max)(std::size_t(1), std::size_t(4096) / sizeof(value_t));
+
+/*
+ * Waits for the first message only,
+ * then takes the fragments have been pushed, batch_count at a time.
+*/
+static std::vector<buff_t> recv_batch(ipc::handle_t h, std::size_t max, std::size_t tm) {
+    std::vector<buff_t> buffs;
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: recv_batch, queue_of(h) == nullptr\n");
+        return buffs;
+    }
+    if (que->connect()) { // wouldn't connect twice
+        info_of(h)->cc_waiter_.broadcast();
+    }
+    value_t    msgs[batch_count];
+    chunk_hold hds [batch_count];
+    auto info   = info_of(h);
+    auto copied = [info, &hds](std::size_t i, value_t const & m) { hold(info, m, hds[i]); };
+    while (buffs.size() < max) {
+        auto n = (ipc::detail::min)(batch_count, max - buffs.size());
+        std::size_t count = 0;
+        if (buffs.empty()) {
+            if (!wait_for(info->rd_waiter_, [&] {
+                    return (count = que->pop_n(msgs, n, copied)) == 0;
+                }, tm, info->wait_, &info->rd_tuner_)) {
+                break;
+            }
+        }
+        else if ((count = que->pop_n(msgs, n, copied)) == 0) {
+            break;
+        }
+        info->wt_waiter_.broadcast();
+        for (std::size_t i = 0; i < count; ++i) {
+            buff_t buff;
+            if (deliver(que, msgs[i], hds[i], buff) && !buff.empty()) {
+                buffs.push_back(std::move(buff));
+            }
+        }
+        // the references left, of the copies dropped for retrying & of the own messages
+        for (auto& hd : hds) hd.reset();
+    }
+    return buffs;
+}
+
+/*
+ * Takes the fragments have been pushed without waiting, until a whole message is delivered.
+ * Returns false if there is no whole message in the ring.
+*/
+static bool poll(ipc::handle_t h, buff_t& buff, reassembly_t& rc) {
+    auto que = queue_of(h);
+    if (que == nullptr) return false;
+    auto info = info_of(h);
+    value_t    msg;
+    chunk_hold hd;
+    bool popped = false, ret = false;
+    while (!ret && que->pop(msg, [info, &hd](value_t const & m) { hold(info, m, hd); })) {
+        popped = true;
+        ret = deliver(que, msg, hd, buff, rc);
+    }
+    if (popped) info_of(h)->wt_waiter_.broadcast();
+    return ret;
+}
+
+// never waits, the fragments in the ring are taken by poll until a whole message is delivered
+static buff_t try_recv(ipc::handle_t h) {
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: try_recv, queue_of(h) == nullptr\n");
+        return {};
+    }
+    if (que->connect()) { // wouldn't connect twice
+        info_of(h)->cc_waiter_.broadcast();
+    }
+    buff_t buff;
+    poll(h, buff, recv_cache());
+    return buff;
+}
+
+// a large message is viewed in its shared chunk, the fragmented ones own a reassembled copy
+static buff_t recv_view(ipc::handle_t h, std::size_t tm) {
+    return recv(h, tm);
+}
+
+}; // detail_impl<Policy, DataSize>
+
+/*
+ * A var_length channel wouldn't split the messages,
+ * each one is pushed into a byte ring as a single record, led by the sender's queue.
+*/
+template <typename Policy>
+struct detail_impl<Policy, var_length> : conn_impl<Policy, var_length> {
+
+using base_t = conn_impl<Policy, var_length>;
+using base_t::info_of;
+using base_t::queue_of;
+
+template <typename F>
+static bool send(F&& try_push, ipc::handle_t h, void const * data, std::size_t size) {
+    if (data == nullptr || size == 0) {
+        ipc::error("fail: send(%p, %zd)\n", data, size);
+        return false;
+    }
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: send, queue_of(h) == nullptr\n");
+        return false;
+    }
+    if (size > que->max_size() - sizeof(void*)) {
+        ipc::error("fail: send, message is too large: %zd\n", size);
+        return false;
+    }
+    return std::forward<F>(try_push)(info_of(h), que, sizeof(void*) + size, [que, data, size](void* p) {
+        std::memcpy(p, &que, sizeof(void*));
+        std::memcpy(static_cast<byte_t*>(p) + sizeof(void*), data, size);
+    });
+}
+
+// a record larger than the ring would never fit in it
+static bool sendable(ipc::handle_t h, std::size_t size) {
+    return base_t::sendable(h, size) && (size <= queue_of(h)->max_size() - sizeof(void*));
+}
+
+static bool send(ipc::handle_t h, void const * data, std::size_t size) {
+    return send([](auto info, auto que, std::size_t size, auto&& write) {
+        if (!push_for(info, [&] { return que->push      (size, write); },
+                            [&] { return que->force_push(size, write); })) {
+            return false;
+        }
+        info->wake_readers();
+        return true;
+    }, h, data, size);
+}
+
+static bool try_send(ipc::handle_t h, void const * data, std::size_t size) {
+    return send([](auto info, auto que, std::size_t size, auto&& write) {
+        if (!wait_for(info->wt_waiter_, [&] {
+                return !que->push(size, write);
+            }, 0, info->wait_, &info->wt_tuner_)) {
+            return false;
+        }
+        info->wake_readers();
+        return true;
+    }, h, data, size);
+}
+
+// each record is reserved by itself, but the readers are only woken when the batch is done or the ring is full
+static bool send_batch(ipc::handle_t h, buff_t const * msgs, std::size_t n) {
+    if (msgs == nullptr && n != 0) {
+        ipc::error("fail: send_batch(%p, %zd)\n", msgs, n);
+        return false;
+    }
+    bool pending = false;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!send([&pending](auto info, auto que, std::size_t size, auto&& write) {
+                if (que->push(size, write)) {
+                    return pending = true;
+                }
+                info->wake_readers();
+                pending = false;
+                if (!push_for(info, [&] { return que->push      (size, write); },
+                                    [&] { return que->force_push(size, write); })) {
+                    return false;
+                }
+                return pending = true;
+            }, h, msgs[i].data(), msgs[i].size())) {
+            if (pending) info_of(h)->wake_readers();
+            return false;
+        }
+    }
+    if (pending) info_of(h)->wake_readers();
+    return true;
+}
+
+// the loaned memory is the record in the ring, after the sender's queue
+static void* loan(ipc::handle_t h, std::size_t size) {
+    auto que = queue_of(h);
+    if (que == nullptr || size == 0) {
+        ipc::error("fail: loan(%p, %zd)\n", h, size);
+        return nullptr;
+    }
+    auto info = info_of(h);
+    if (info->loan_ != nullptr) {
+        ipc::error("fail: loan, the last loan hasn't been committed\n");
+        return nullptr;
+    }
+    if (size > que->max_size() - sizeof(void*)) {
+        ipc::error("fail: loan, message is too large: %zd\n", size);
+        return nullptr;
+    }
+    void* p = nullptr;
+    typename base_t::queue_t::elems_t::pos_t pos;
+    if (!push_for(info, [&] { return (p = que->loan      (sizeof(void*) + size, pos)) != nullptr; },
+                        [&] { return (p = que->force_loan(sizeof(void*) + size, pos)) != nullptr; })) {
+        return nullptr;
+    }
+    std::memcpy(p, &que, sizeof(void*));
+    info->loan_     = p;
+    info->loan_pos_ = pos;
+    return static_cast<byte_t*>(p) + sizeof(void*);
+}
+
+static bool commit(ipc::handle_t h) {
+    auto que = queue_of(h);
+    if (que == nullptr || info_of(h)->loan_ == nullptr) {
+        ipc::error("fail: commit, nothing has been loaned\n");
+        return false;
+    }
+    que->commit(info_of(h)->loan_pos_);
+    info_of(h)->loan_ = nullptr;
+    info_of(h)->wake_readers();
+    return true;
+}
+
+static void disconnect(ipc::handle_t h) {
+    auto que = queue_of(h);
+    if (que != nullptr && info_of(h)->loan_ != nullptr) {
+        que->commit(info_of(h)->loan_pos_, true); // cancel it
+    }
+    base_t::disconnect(h);
+}
+
+// copies a record out of the ring, with its sender
+static bool pop(typename base_t::queue_t* que, buff_t& buff, void*& sender) {
+    return que->pop([&buff, &sender](void* p, std::size_t size) {
+        std::memcpy(&sender, p, sizeof(void*));
+        size -= sizeof(void*);
+        auto ptr = mem::alloc(size);
+        std::memcpy(ptr, static_cast<byte_t*>(p) + sizeof(void*), size);
+        buff = buff_t { ptr, size, mem::free };
+    });
+}
+
+static buff_t recv(ipc::handle_t h, std::size_t tm) {
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: recv, queue_of(h) == nullptr\n");
+        return {};
+    }
+    if (que->connect()) { // wouldn't connect twice
+        info_of(h)->cc_waiter_.broadcast();
+    }
+    while (1) {
+        buff_t buff;
+        void* sender = nullptr;
+        if (!wait_for(info_of(h)->rd_waiter_, [que, &buff, &sender] {
+                return !pop(que, buff, sender);
+            }, tm, info_of(h)->wait_, &info_of(h)->rd_tuner_)) {
             return {};
         }
         info_of(h)->wt_waiter_.broadcast();
-        if (msg.head_.que_ == nullptr) {
-            ipc::error("fail: recv, msg.head_.que_ == nullptr\n");
+        if (sender == nullptr) {
+            ipc::error("fail: recv, sender == nullptr\n");
+            return {};
+        }
+        if (sender == que) continue; // pop next
+        return buff;
+    }
+}
+
+static std::vector<buff_t> recv_batch(ipc::handle_t h, std::size_t max, std::size_t tm) {
+    std::vector<buff_t> buffs;
+    if (max == 0) return buffs;
+    auto buff = recv(h, tm);
+    if (buff.empty()) return buffs;
+    buffs.push_back(std::move(buff));
+    auto que = queue_of(h);
+    bool popped = false;
+    while (buffs.size() < max) {
+        void* sender = nullptr;
+        if (!pop(que, buff, sender)) break;
+        popped = true;
+        if (sender == nullptr || sender == que) continue;
+        buffs.push_back(std::move(buff));
+    }
+    if (popped) info_of(h)->wt_waiter_.broadcast();
+    return buffs;
+}
+
+// never waits, the records of its own are skipped
+static buff_t try_recv(ipc::handle_t h) {
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: try_recv, queue_of(h) == nullptr\n");
+        return {};
+    }
+    if (que->connect()) { // wouldn't connect twice
+        info_of(h)->cc_waiter_.broadcast();
+    }
+    buff_t buff;
+    void* sender = nullptr;
+    bool popped  = false;
+    while (pop(que, buff, sender)) {
+        popped = true;
+        if (sender != que) break;
+    }
+    if (!popped) return {};
+    info_of(h)->wt_waiter_.broadcast();
+    if (sender == nullptr) {
+        ipc::error("fail: try_recv, sender == nullptr\n");
+        return {};
+    }
+    if (sender == que) return {};
+    return buff;
+}
+
+using pos_t = typename base_t::queue_t::elems_t::pos_t;
+
+struct lease_t {
+    typename base_t::queue_t* que_;
+    waiter*                   wt_waiter_;
+    pos_t                     pos_;
+};
+
+// the view points at the record in the ring, which is released when the view is destroyed
+static buff_t recv_view(ipc::handle_t h, std::size_t tm) {
+    auto que = queue_of(h);
+    if (que == nullptr) {
+        ipc::error("fail: recv_view, queue_of(h) == nullptr\n");
+        return {};
+    }
+    if (que->connect()) { // wouldn't connect twice
+        info_of(h)->cc_waiter_.broadcast();
+    }
+    while (1) {
+        void* p = nullptr;
+        std::size_t size = 0;
+        pos_t pos;
+        if (!wait_for(info_of(h)->rd_waiter_, [que, &p, &size, &pos] {
+                return (p = que->pop_view(size, pos)) == nullptr;
+            }, tm, info_of(h)->wait_, &info_of(h)->rd_tuner_)) {
             return {};
         }
-        if (msg.head_.que_ == que) continue; // pop next
-        // msg.head_.remain_ may minus & abs(msg.head_.remain_) < data_length
-        auto remain = static_cast<std::size_t>(static_cast<int>(data_length) + msg.head_.remain_);
-        // find cache with msg.head_.id_
-        auto cac_it = rc.find(msg.head_.id_);
-        if (cac_it == rc.end()) {
-            if (remain <= data_length) {
-                return make_cache(msg.data_, remain);
+        void* sender = nullptr;
+        std::memcpy(&sender, p, sizeof(void*));
+        if (sender == que || sender == nullptr) {
+            que->release(pos);
+            info_of(h)->wt_waiter_.broadcast();
+            if (sender == nullptr) {
+                ipc::error("fail: recv_view, sender == nullptr\n");
+                return {};
             }
-            else {
-                // gc
-                if (rc.size() > 1024) {
-                    std::vector<msg_id_t> need_del;
-                    for (auto const & pair : rc) {
-                        auto cmp = std::minmax(msg.head_.id_, pair.first);
-                        if (cmp.second - cmp.first > 8192) {
-                            need_del.push_back(pair.first);
-                        }
-                    }
-                    for (auto id : need_del) rc.erase(id);
-                }
-                // cache the first message fragment
-                rc.emplace(msg.head_.id_, cache_t { data_length, make_cache(msg.data_, remain) });
+            continue; // pop next
+        }
+        auto lease = mem::alloc<lease_t>(lease_t { que, &(info_of(h)->wt_waiter_), pos });
+        return buff_t {
+            static_cast<byte_t*>(p) + sizeof(void*), size - sizeof(void*),
+            [](void* p, std::size_t) {
+                auto lease = static_cast<lease_t*>(p);
+                lease->que_->release(lease->pos_);
+                lease->wt_waiter_->broadcast();
+                mem::free(lease);
+            },
+            lease
+        };
+    }
+}
+
+}; // detail_impl<Policy, var_length>
+
+template <typename Flag, std::size_t DataSize>
+using policy_t = std::conditional_t<DataSize == var_length,
+                                    policy::choose<circ::byte_array, Flag>,
+                                    policy::choose<circ::elem_array, Flag>>;
+
+/*
+ * The latest-value slots: a publisher claims a version from ver_,
+ * & writes it into the slot holding the older value, which is never the one just published.
+ * A slot's seq_ is the version it holds * 2, odd while a publisher is copying into it.
+ * pub_ is the newest version which has been written completely.
+ * A reader copies a slot between two loads of its seq_, & falls back to the other slot if they differ,
+ * so a publisher stuck in one slot blocks neither the readers nor the other publishers.
+*/
+struct alignas(circ::cache_line_size) latest_head_t {
+    std::atomic<std::uint64_t> ver_;
+    std::atomic<std::uint64_t> pub_;
+};
+
+struct alignas(circ::cache_line_size) latest_slot_t {
+    std::atomic<std::uint64_t> seq_;
+};
+
+struct latest_info_t {
+    using size_t_ = std::atomic<std::size_t>;
+
+    waiter      waiter_;
+    shm::handle size_h_, slot_h_;
+    std::size_t size_ = 0;
+
+    latest_info_t(char const * name)
+        : waiter_((std::string{ "__LT_WAITER__" } + name).c_str()) {
+    }
+
+    bool open(char const * name, std::size_t size) {
+        // the first one decides the slot size, like agree_elem_max
+        if (!size_h_.acquire((std::string{ "__LT_SIZE__" } + name).c_str(), sizeof(size_t_))) {
+            return false;
+        }
+        std::size_t expected = 0;
+        if (!static_cast<size_t_*>(size_h_.get())->compare_exchange_strong(expected, size, std::memory_order_acq_rel) &&
+            (expected != size)) {
+            ipc::error("fail: latest connect(%s), the size is %zd, not %zd\n", name, expected, size);
+            return false;
+        }
+        size_ = size;
+        return slot_h_.acquire((std::string{ "__LT_SLOT__" } + name).c_str(), sizeof(latest_head_t) + stride() * 2);
+    }
+
+    // each slot is a seq_ & the data, padded to cache lines
+    std::size_t stride() const {
+        return (sizeof(latest_slot_t) + size_ + circ::cache_line_size - 1) /
+                circ::cache_line_size * circ::cache_line_size;
+    }
+
+    latest_head_t* head() const {
+        return static_cast<latest_head_t*>(slot_h_.get());
+    }
+
+    latest_slot_t* slot(std::size_t i) const {
+        return reinterpret_cast<latest_slot_t*>(reinterpret_cast<byte_t*>(head() + 1) + stride() * i);
+    }
+
+    void* data(std::size_t i) const {
+        return slot(i) + 1;
+    }
+};
+
+constexpr static latest_info_t* latest_of(ipc::handle_t h) {
+    return static_cast<latest_info_t*>(h);
+}
+
+/*
+ * A sharded channel is a table of shard_impl::shard_max single-producer broadcast rings (routes).
+ * Each sender claims one ring, so the senders never touch each other's data,
+ * & the receivers merge all the claimed rings.
+*/
+using shard_flag_t = ipc::wr<relat::single, relat::multi, trans::broadcast>;
+using shard_ring_t = detail_impl<policy_t<shard_flag_t, data_length>, data_length>;
+using shard_mask_t = std::uint64_t;
+using shard_time_t = std::uint64_t; // leads each message, in nanoseconds of the steady clock
+
+static_assert(sizeof(shard_mask_t) * CHAR_BIT == shard_impl::shard_max, "shard_max must match shard_mask_t");
+
+struct alignas(circ::cache_line_size) shard_table_t {
+    std::atomic<shard_mask_t>  shards_;  // bit i: the ring i has been claimed by a sender
+    std::atomic<std::uint32_t> readers_; // the connected receivers
+};
+
+// a ring merged by a receiver
+struct shard_reader_t {
+    ipc::handle_t h_ = nullptr;
+    reassembly_t  rc_;         // the fragments of a ring are reassembled apart from the others
+    buff_t        head_;       // the message read ahead by the ordered merge
+    shard_time_t  time_ = 0;
+};
+
+struct shard_info_t {
+    std::string name_;
+    std::size_t elem_max_;
+    unsigned    mode_;
+    waiter      waiter_;       // the receivers wait on it for all the rings
+    shm::handle table_h_;
+
+    // as a sender
+    std::size_t   id_   = invalid_value;
+    ipc::handle_t ring_ = nullptr;
+
+    // as a receiver
+    shard_mask_t    seen_ = 0;
+    std::size_t     next_ = 0;
+    shard_reader_t* readers_[shard_impl::shard_max] {};
+
+    shard_info_t(char const * name, unsigned mode, std::size_t elem_max)
+        : name_    (name)
+        , elem_max_(elem_max)
+        , mode_    (mode)
+        , waiter_  ((std::string{ "__SD_WAITER__" } + name).c_str())
+        , table_h_ ((std::string{ "__SD_TABLE__" } + name).c_str(), sizeof(shard_table_t)) {
+    }
+
+    shard_table_t* table() const {
+        return static_cast<shard_table_t*>(table_h_.get());
+    }
+
+    std::string ring_name(std::size_t i) const {
+        return std::string{ "__SD_RING__" } + std::to_string(i) + "__" + name_;
+    }
+
+    bool claim() {
+        auto table = this->table();
+        auto mask  = table->shards_.load(std::memory_order_acquire);
+        do {
+            if (~mask == 0) {
+                ipc::error("fail: shard claim(%s), all %zd shards are in use\n", name_.c_str(), std::size_t(shard_impl::shard_max));
+                return false;
             }
+            id_ = 0;
+            while (mask & (shard_mask_t(1) << id_)) ++id_;
+        } while (!table->shards_.compare_exchange_weak(mask, mask | (shard_mask_t(1) << id_), std::memory_order_acq_rel));
+        // a handle wouldn't receive its own messages
+        if (readers_[id_] != nullptr) {
+            shard_ring_t::disconnect(readers_[id_]->h_);
+            mem::free(readers_[id_]);
+            readers_[id_] = nullptr;
         }
-        // has cached before this message
-        else {
-            auto& cac = cac_it->second;
-            // this is the last message fragment
-            if (msg.head_.remain_ <= 0) {
-                cac.append(&(msg.data_), remain);
-                // finish this message, erase it from cache
-                auto buff = std::move(cac.buff_);
-                rc.erase(cac_it);
-                return buff;
+        ring_ = shard_ring_t::connect(ring_name(id_).c_str(), false, elem_max_);
+        if (ring_ == nullptr) {
+            table->shards_.fetch_and(~(shard_mask_t(1) << id_), std::memory_order_acq_rel);
+            id_ = invalid_value;
+            return false;
+        }
+        // the waiting receivers open the new ring now, the busy ones at their next receiving
+        waiter_.broadcast();
+        return true;
+    }
+
+    void unclaim() {
+        if (ring_ == nullptr) return;
+        shard_ring_t::disconnect(ring_);
+        ring_ = nullptr;
+        table()->shards_.fetch_and(~(shard_mask_t(1) << id_), std::memory_order_acq_rel);
+        id_ = invalid_value;
+    }
+
+    // opens the rings claimed since the last time, a ring is kept until disconnecting
+    void refresh() {
+        auto mask = table()->shards_.load(std::memory_order_acquire) & ~seen_;
+        seen_ |= mask;
+        for (std::size_t i = 0; mask != 0; ++i, mask >>= 1) {
+            if ((mask & 1) == 0 || i == id_) continue;
+            auto r = mem::alloc<shard_reader_t>();
+            if ((r->h_ = shard_ring_t::connect(ring_name(i).c_str(), true, elem_max_)) == nullptr) {
+                mem::free(r);
+                continue;
             }
-            // there are remain datas after this message
-            cac.append(&(msg.data_), data_length);
+            readers_[i] = r;
+        }
+    }
+
+    void close() {
+        for (auto& r : readers_) {
+            if (r == nullptr) continue;
+            shard_ring_t::disconnect(r->h_);
+            mem::free(r);
+            r = nullptr;
+        }
+    }
+
+    bool poll(shard_reader_t* r) {
+        if (!r->head_.empty()) return true;
+        buff_t buff;
+        if (!shard_ring_t::poll(r->h_, buff, r->rc_) || (buff.size() < sizeof(shard_time_t))) {
+            return false;
         }
+        std::memcpy(&r->time_, buff.data(), sizeof(shard_time_t));
+        r->head_ = std::move(buff);
+        return true;
     }
+
+    // the next ring having a message after the last one returned
+    shard_reader_t* next() {
+        for (std::size_t k = 0; k < shard_impl::shard_max; ++k) {
+            auto i = (next_ + k) % shard_impl::shard_max;
+            if ((readers_[i] != nullptr) && poll(readers_[i])) {
+                next_ = i + 1;
+                return readers_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // the ring having the oldest message, all the rings are read ahead by one message
+    shard_reader_t* oldest() {
+        shard_reader_t* ret = nullptr;
+        for (auto r : readers_) {
+            if ((r != nullptr) && poll(r) && ((ret == nullptr) || (r->time_ < ret->time_))) {
+                ret = r;
+            }
+        }
+        return ret;
+    }
+
+    // nothing could be received until a sender pushes or claims a ring
+    bool idle() const {
+        if ((table()->shards_.load(std::memory_order_acquire) & ~seen_) != 0) return false;
+        for (auto r : readers_) {
+            if ((r != nullptr) && (!r->head_.empty() || !shard_ring_t::queue_of(r->h_)->empty())) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+constexpr static shard_info_t* shard_of(ipc::handle_t h) {
+    return static_cast<shard_info_t*>(h);
 }
 
-static buff_t try_recv(ipc::handle_t h) {
-    return recv(h, 0);
+// strips the leading time of a message, the buffer is kept without copying
+buff_t shard_take(shard_reader_t* r) {
+    auto buff = mem::alloc<buff_t>(std::move(r->head_));
+    return buff_t {
+        static_cast<byte_t*>(buff->data()) + sizeof(shard_time_t), buff->size() - sizeof(shard_time_t),
+        [](void* p, std::size_t) {
+            mem::free(static_cast<buff_t*>(p));
+        }, buff };
 }
 
-}; // detail_impl<Policy>
+/*
+ * A partitioned channel is a table of the partitions' owners & the connected receivers,
+ * & part_count multi-producer unicast rings.
+ * Each receiver computes its partitions from the receivers' mask by itself, then gives up or takes
+ * the owners by CAS, so a partition never has two owners, & is only taken after its last owner gave it up.
+ * The fragments of a message are reassembled by the receiver having taken them, so a partition is kept
+ * until its partly received messages are done, or their senders have stopped for default_timeut.
+*/
+using part_flag_t = ipc::wr<relat::multi, relat::multi, trans::unicast>;
+using part_ring_t = detail_impl<policy_t<part_flag_t, data_length>, data_length>;
+using part_mask_t = std::uint64_t;
 
-template <typename Flag>
-using policy_t = policy::choose<circ::elem_array, Flag>;
+static_assert(sizeof(part_mask_t) * CHAR_BIT == part_impl::part_max, "part_max must match part_mask_t");
+
+// counts the messages sent to a partition (& the times it was full),
+// since a unicast ring couldn't tell a reader it's empty
+struct alignas(circ::cache_line_size) part_sent_t {
+    std::atomic<std::uint64_t> count_;
+};
+
+struct alignas(circ::cache_line_size) part_table_t {
+    std::atomic<std::uint32_t> parts_;                     // decided by the first connection
+    std::atomic<part_mask_t>   members_;                   // bit i: the receiver i is connected
+    std::atomic<std::uint32_t> owners_[part_impl::part_max]; // the owner's id + 1, or 0
+    part_sent_t                sent_  [part_impl::part_max];
+};
+
+struct part_info_t {
+    std::string name_;
+    std::size_t elem_max_;
+    unsigned    mode_;
+    waiter      waiter_;       // the receivers wait on it for their partitions & the rebalancing
+    shm::handle table_h_;
+    std::size_t parts_ = 0;
+
+    // as a sender, the rings are opened at the first sending to them
+    ipc::handle_t senders_[part_impl::part_max] {};
+
+    // as a receiver
+    std::size_t  id_      = invalid_value;
+    part_mask_t  members_ = 0; // the last seen
+    part_mask_t  target_  = 0; // the partitions assigned to it by members_
+    part_mask_t  owned_   = 0;
+    part_mask_t  kept_    = 0; // the partitions no longer assigned, kept for their partial messages
+    std::chrono::steady_clock::time_point kept_at_;
+    std::size_t  next_    = 0;
+    ipc::handle_t readers_[part_impl::part_max] {};
+    reassembly_t  rcs_    [part_impl::part_max];
+    std::uint64_t sent_   [part_impl::part_max] {}; // the counts seen before the last polling
+
+    part_info_t(char const * name, unsigned mode, std::size_t elem_max)
+        : name_    (name)
+        , elem_max_(elem_max)
+        , mode_    (mode)
+        , waiter_  ((std::string{ "__PT_WAITER__" } + name).c_str())
+        , table_h_ ((std::string{ "__PT_TABLE__" } + name).c_str(), sizeof(part_table_t)) {
+    }
+
+    part_table_t* table() const {
+        return static_cast<part_table_t*>(table_h_.get());
+    }
+
+    std::string ring_name(std::size_t i) const {
+        return std::string{ "__PT_RING__" } + std::to_string(i) + "__" + name_;
+    }
+
+    bool prepare(std::size_t parts) {
+        auto table = this->table();
+        std::uint32_t expected = 0;
+        parts = (ipc::detail::min)((ipc::detail::max)(parts, std::size_t { 1 }), std::size_t { part_impl::part_max });
+        if (!table->parts_.compare_exchange_strong(expected, static_cast<std::uint32_t>(parts),
+                                                   std::memory_order_acq_rel)) {
+            parts = expected; // recorded already
+        }
+        parts_ = parts;
+        return true;
+    }
+
+    bool join() {
+        auto table = this->table();
+        auto mask  = table->members_.load(std::memory_order_acquire);
+        do {
+            if (~mask == 0) {
+                ipc::error("fail: part join(%s), all %zd receivers are connected\n", name_.c_str(), std::size_t(part_impl::part_max));
+                return false;
+            }
+            id_ = 0;
+            while (mask & (part_mask_t(1) << id_)) ++id_;
+        } while (!table->members_.compare_exchange_weak(mask, mask | (part_mask_t(1) << id_), std::memory_order_acq_rel));
+        // the others give up some partitions to it
+        waiter_.broadcast();
+        return true;
+    }
+
+    void leave() {
+        if (id_ == invalid_value) return;
+        auto table = this->table();
+        table->members_.fetch_and(~(part_mask_t(1) << id_), std::memory_order_acq_rel);
+        release(owned_);
+        waiter_.broadcast();
+        id_ = invalid_value;
+    }
+
+    void release(part_mask_t mask) {
+        auto table = this->table();
+        for (std::size_t i = 0; mask != 0; ++i, mask >>= 1) {
+            if ((mask & 1) == 0) continue;
+            auto owner = static_cast<std::uint32_t>(id_ + 1);
+            table->owners_[i].compare_exchange_strong(owner, 0, std::memory_order_acq_rel);
+            owned_ &= ~(part_mask_t(1) << i);
+            // the rest of a partial message would be dropped by the next owner
+            rcs_[i].clear();
+        }
+    }
+
+    // gives up the partitions no longer assigned, but the ones having a partial message
+    void give_up() {
+        using clock_t = std::chrono::steady_clock;
+        auto mask = owned_ & ~target_;
+        if (mask == 0) return;
+        part_mask_t keep = 0;
+        for (std::size_t i = 0; i < parts_; ++i) {
+            auto bit = part_mask_t(1) << i;
+            if ((mask & bit) && rcs_[i].partial()) keep |= bit;
+        }
+        if (keep != 0) {
+            if (kept_ == 0) kept_at_ = clock_t::now();
+            else if (clock_t::now() - kept_at_ >= std::chrono::milliseconds(default_timeut)) {
+                keep = 0; // the senders have stopped in the middle of their messages
+            }
+        }
+        kept_ = keep;
+        if ((mask & ~keep) == 0) return;
+        release(mask & ~keep);
+        waiter_.broadcast();
+    }
+
+    // the partitions of the receiver ranked rank among n receivers
+    part_mask_t assigned(part_mask_t members) const {
+        std::size_t n = 0, rank = 0;
+        for (auto m = members; m != 0; m &= (m - 1)) ++n;
+        for (auto m = members & ((part_mask_t(1) << id_) - 1); m != 0; m &= (m - 1)) ++rank;
+        part_mask_t ret = 0;
+        if (n == 0) return ret;
+        for (std::size_t i = rank; i < parts_; i += n) ret |= (part_mask_t(1) << i);
+        return ret;
+    }
+
+    // gives up the partitions no longer assigned, & takes the assigned ones given up by the others
+    void rebalance() {
+        auto table   = this->table();
+        auto members = table->members_.load(std::memory_order_acquire);
+        if (members != members_) {
+            members_ = members;
+            target_  = assigned(members);
+        }
+        give_up();
+        auto mask = target_ & ~owned_;
+        for (std::size_t i = 0; mask != 0; ++i, mask >>= 1) {
+            if ((mask & 1) == 0) continue;
+            std::uint32_t owner = 0;
+            if (!table->owners_[i].compare_exchange_strong(owner, static_cast<std::uint32_t>(id_ + 1),
+                                                           std::memory_order_acq_rel)) {
+                continue; // the last owner hasn't given it up yet
+            }
+            if ((readers_[i] == nullptr) &&
+                (readers_[i] = part_ring_t::connect(ring_name(i).c_str(), true, elem_max_)) == nullptr) {
+                table->owners_[i].store(0, std::memory_order_release);
+                continue;
+            }
+            owned_ |= (part_mask_t(1) << i);
+        }
+    }
+
+    void close() {
+        for (auto& r : readers_) {
+            if (r == nullptr) continue;
+            part_ring_t::disconnect(r);
+            r = nullptr;
+        }
+        for (auto& r : senders_) {
+            if (r == nullptr) continue;
+            part_ring_t::disconnect(r);
+            r = nullptr;
+        }
+    }
+
+    // the next owned partition having a message after the last one returned
+    bool next(buff_t& buff) {
+        auto table = this->table();
+        for (std::size_t i = 0; i < parts_; ++i) {
+            sent_[i] = table->sent_[i].count_.load(std::memory_order_acquire);
+        }
+        for (std::size_t k = 0; k < parts_; ++k) {
+            auto i = (next_ + k) % parts_;
+            if ((owned_ & (part_mask_t(1) << i)) && part_ring_t::poll(readers_[i], buff, rcs_[i])) {
+                next_ = i + 1;
+                // a kept partition is given up once its partial messages are done
+                if (kept_ & (part_mask_t(1) << i)) give_up();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // nothing could be received until a message is sent to an owned partition or the receivers change
+    bool idle() const {
+        auto table = this->table();
+        if (table->members_.load(std::memory_order_acquire) != members_) return false;
+        auto pending = target_ & ~owned_;
+        for (std::size_t i = 0; i < parts_; ++i) {
+            auto bit = part_mask_t(1) << i;
+            if ((owned_ & bit) && (table->sent_[i].count_.load(std::memory_order_acquire) != sent_[i])) return false;
+            if ((pending & bit) && (table->owners_[i].load(std::memory_order_acquire) == 0)) return false;
+        }
+        return true;
+    }
+};
+
+constexpr static part_info_t* part_of(ipc::handle_t h) {
+    return static_cast<part_info_t*>(h);
+}
+
+// FNV-1a of the key's bytes, the same in every process
+std::size_t part_hash(void const * key, std::size_t size) {
+    std::uint64_t h = 14695981039346656037ull;
+    for (std::size_t i = 0; i < size; ++i) {
+        h = (h ^ static_cast<byte_t const *>(key)[i]) * 1099511628211ull;
+    }
+    return static_cast<std::size_t>(h ^ (h >> 32));
+}
 
 } // internal-linkage
 
 namespace ipc {
 
-template <typename Flag>
-ipc::handle_t chan_impl<Flag>::connect(char const * name, unsigned mode) {
-    return detail_impl<policy_t<Flag>>::connect(name, mode & receiver);
+template <typename Flag, std::size_t DataSize>
+ipc::handle_t chan_impl<Flag, DataSize>::connect(char const * name, unsigned mode, std::size_t elem_max) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::connect(name, mode & receiver, elem_max);
 }
 
-template <typename Flag>
-void chan_impl<Flag>::disconnect(ipc::handle_t h) {
-    detail_impl<policy_t<Flag>>::disconnect(h);
+template <typename Flag, std::size_t DataSize>
+void chan_impl<Flag, DataSize>::disconnect(ipc::handle_t h) {
+    detail_impl<policy_t<Flag, DataSize>, DataSize>::disconnect(h);
 }
 
-template <typename Flag>
-std::size_t chan_impl<Flag>::recv_count(ipc::handle_t h) {
-    return detail_impl<policy_t<Flag>>::recv_count(h);
+template <typename Flag, std::size_t DataSize>
+std::size_t chan_impl<Flag, DataSize>::recv_count(ipc::handle_t h) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::recv_count(h);
 }
 
-template <typename Flag>
-bool chan_impl<Flag>::wait_for_recv(ipc::handle_t h, std::size_t r_count, std::size_t tm) {
-    return detail_impl<policy_t<Flag>>::wait_for_recv(h, r_count, tm);
+template <typename Flag, std::size_t DataSize>
+std::size_t chan_impl<Flag, DataSize>::lost_count(ipc::handle_t h) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::lost_count(h);
 }
 
-template <typename Flag>
-bool chan_impl<Flag>::send(ipc::handle_t h, void const * data, std::size_t size) {
-    return detail_impl<policy_t<Flag>>::send(h, data, size);
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::wait_for_recv(ipc::handle_t h, std::size_t r_count, std::size_t tm) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::wait_for_recv(h, r_count, tm);
 }
 
-template <typename Flag>
-buff_t chan_impl<Flag>::recv(ipc::handle_t h, std::size_t tm) {
-    return detail_impl<policy_t<Flag>>::recv(h, tm);
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::send(ipc::handle_t h, void const * data, std::size_t size) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::send(h, data, size);
 }
 
-template <typename Flag>
-bool chan_impl<Flag>::try_send(ipc::handle_t h, void const * data, std::size_t size) {
-    return detail_impl<policy_t<Flag>>::try_send(h, data, size);
+template <typename Flag, std::size_t DataSize>
+buff_t chan_impl<Flag, DataSize>::recv(ipc::handle_t h, std::size_t tm) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::recv(h, tm);
 }
 
-template <typename Flag>
-buff_t chan_impl<Flag>::try_recv(ipc::handle_t h) {
-    return detail_impl<policy_t<Flag>>::try_recv(h);
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::send_batch(ipc::handle_t h, buff_t const * msgs, std::size_t n) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::send_batch(h, msgs, n);
+}
+
+template <typename Flag, std::size_t DataSize>
+std::vector<buff_t> chan_impl<Flag, DataSize>::recv_batch(ipc::handle_t h, std::size_t max, std::size_t tm) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::recv_batch(h, max, tm);
+}
+
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::try_send(ipc::handle_t h, void const * data, std::size_t size) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::try_send(h, data, size);
+}
+
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::sendable(ipc::handle_t h, std::size_t size) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::sendable(h, size);
 }
 
-template struct chan_impl<ipc::wr<relat::single, relat::single, trans::unicast  >>;
-template struct chan_impl<ipc::wr<relat::single, relat::multi , trans::unicast  >>;
-template struct chan_impl<ipc::wr<relat::multi , relat::multi , trans::unicast  >>;
-template struct chan_impl<ipc::wr<relat::single, relat::multi , trans::broadcast>>;
-template struct chan_impl<ipc::wr<relat::multi , relat::multi , trans::broadcast>>;
+template <typename Flag, std::size_t DataSize>
+buff_t chan_impl<Flag, DataSize>::try_recv(ipc::handle_t h) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::try_recv(h);
+}
+
+template <typename Flag, std::size_t DataSize>
+buff_t chan_impl<Flag, DataSize>::recv_view(ipc::handle_t h, std::size_t tm) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::recv_view(h, tm);
+}
+
+template <typename Flag, std::size_t DataSize>
+void* chan_impl<Flag, DataSize>::loan(ipc::handle_t h, std::size_t size) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::loan(h, size);
+}
+
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::commit(ipc::handle_t h) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::commit(h);
+}
+
+template <typename Flag, std::size_t DataSize>
+void chan_impl<Flag, DataSize>::set_overflow(ipc::handle_t h, overflow ov) {
+    detail_impl<policy_t<Flag, DataSize>, DataSize>::set_overflow(h, ov);
+}
+
+template <typename Flag, std::size_t DataSize>
+void chan_impl<Flag, DataSize>::set_wait(ipc::handle_t h, wait_strategy ws) {
+    detail_impl<policy_t<Flag, DataSize>, DataSize>::set_wait(h, ws);
+}
+
+template <typename Flag, std::size_t DataSize>
+wait_stats chan_impl<Flag, DataSize>::stats(ipc::handle_t h, unsigned mode) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::stats(h, mode);
+}
+
+template <typename Flag, std::size_t DataSize>
+int chan_impl<Flag, DataSize>::ready_fd(ipc::handle_t h) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::ready_fd(h);
+}
+
+template <typename Flag, std::size_t DataSize>
+bool chan_impl<Flag, DataSize>::arm(ipc::handle_t h) {
+    return detail_impl<policy_t<Flag, DataSize>, DataSize>::arm(h);
+}
+
+#undef IPC_CHAN_IMPL_INSTANTIATE_
+#define IPC_CHAN_IMPL_INSTANTIATE_(DS)                                                      \
+    template struct chan_impl<ipc::wr<relat::single, relat::single, trans::unicast  >, DS>; \
+    template struct chan_impl<ipc::wr<relat::single, relat::multi , trans::unicast  >, DS>; \
+    template struct chan_impl<ipc::wr<relat::multi , relat::multi , trans::unicast  >, DS>; \
+    template struct chan_impl<ipc::wr<relat::single, relat::multi , trans::broadcast>, DS>; \
+    template struct chan_impl<ipc::wr<relat::multi , relat::multi , trans::broadcast>, DS>
+
+IPC_CHAN_IMPL_INSTANTIATE_(data_length);
+IPC_CHAN_IMPL_INSTANTIATE_(256);
+IPC_CHAN_IMPL_INSTANTIATE_(1024);
+IPC_CHAN_IMPL_INSTANTIATE_(4096);
+IPC_CHAN_IMPL_INSTANTIATE_(var_length);
+
+// the byte ring doesn't support wr_cursor, wr_lossy & wr_slot
+template struct chan_impl<ipc::wr_cursor, data_length>;
+template struct chan_impl<ipc::wr_cursor, 256>;
+template struct chan_impl<ipc::wr_cursor, 1024>;
+template struct chan_impl<ipc::wr_cursor, 4096>;
+template struct chan_impl<ipc::wr_lossy , data_length>;
+template struct chan_impl<ipc::wr_lossy , 256>;
+template struct chan_impl<ipc::wr_lossy , 1024>;
+template struct chan_impl<ipc::wr_lossy , 4096>;
+template struct chan_impl<ipc::wr_slot  , data_length>;
+template struct chan_impl<ipc::wr_slot  , 256>;
+template struct chan_impl<ipc::wr_slot  , 1024>;
+template struct chan_impl<ipc::wr_slot  , 4096>;
+
+#undef IPC_CHAN_IMPL_INSTANTIATE_
+
+ipc::handle_t latest_impl::connect(char const * name, std::size_t size) {
+    if (name == nullptr || name[0] == '\0' || size == 0) {
+        ipc::error("fail: latest connect(%p, %zd)\n", name, size);
+        return nullptr;
+    }
+    auto h = mem::alloc<latest_info_t>(name);
+    if (!h->open(name, size)) {
+        mem::free(h);
+        return nullptr;
+    }
+    return h;
+}
+
+void latest_impl::disconnect(ipc::handle_t h) {
+    if (latest_of(h) == nullptr) return;
+    mem::free(latest_of(h));
+}
+
+std::uint64_t latest_impl::version(ipc::handle_t h) {
+    auto info = latest_of(h);
+    if (info == nullptr) return 0;
+    return info->head()->pub_.load(std::memory_order_acquire);
+}
+
+/*
+ * A publisher takes a free slot holding an older version than its own.
+ * If the other publishers are writing older versions into both slots, it retries for a few rounds,
+ * as its value is the newest one, & gives up if they don't finish (they might have died).
+ * If a newer version has been written (or is being written) meanwhile,
+ * this one is conflated & succeeds without writing.
+*/
+bool latest_impl::publish(ipc::handle_t h, void const * data) {
+    auto info = latest_of(h);
+    if (info == nullptr || data == nullptr) {
+        ipc::error("fail: latest publish(%p, %p)\n", h, data);
+        return false;
+    }
+    auto head = info->head();
+    auto ver  = head->ver_.fetch_add(1, std::memory_order_relaxed) + 1;
+    constexpr unsigned round_max = 64;
+    for (unsigned r = 0, k = 0;;) {
+        std::uint64_t seq[2] = {
+            info->slot(0)->seq_.load(std::memory_order_relaxed),
+            info->slot(1)->seq_.load(std::memory_order_relaxed)
+        };
+        // the slot holding the older version first
+        std::size_t i = ((seq[0] >> 1) <= (seq[1] >> 1)) ? 0 : 1;
+        if ((seq[i] & 1) || ((seq[i] >> 1) >= ver)) i ^= 1;
+        if ((seq[i] & 1) || ((seq[i] >> 1) >= ver)) {
+            if (((seq[0] >> 1) > ver) || ((seq[1] >> 1) > ver)) {
+                return true; // a newer value has been (or is being) written
+            }
+            // both slots are being written with older values
+            if (++r >= round_max) return false;
+            ipc::yield(k);
+            continue;
+        }
+        auto slot = info->slot(i);
+        if (!slot->seq_.compare_exchange_strong(seq[i], (ver << 1) | 1, std::memory_order_acquire)) {
+            continue; // taken by another publisher
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(info->data(i), data, info->size_);
+        slot->seq_.store(ver << 1, std::memory_order_release);
+        // pub_ only goes forward
+        auto pub = head->pub_.load(std::memory_order_relaxed);
+        while ((pub < ver) &&
+               !head->pub_.compare_exchange_weak(pub, ver, std::memory_order_release)) ;
+        info->waiter_.broadcast();
+        return true;
+    }
+}
+
+/*
+ * The newer slot is tried first, then the other one.
+ * A copy is only torn if the slot was rewritten meanwhile, which takes two newer publications,
+ * so it gives up after a few rounds rather than spinning on a flood of them.
+*/
+std::uint64_t latest_impl::read(ipc::handle_t h, void * data) {
+    auto info = latest_of(h);
+    if (info == nullptr || data == nullptr) {
+        ipc::error("fail: latest read(%p, %p)\n", h, data);
+        return 0;
+    }
+    if (info->head()->pub_.load(std::memory_order_acquire) == 0) {
+        return 0; // nothing published yet
+    }
+    constexpr unsigned round_max = 64;
+    for (unsigned r = 0, k = 0; r < round_max; ++r, ipc::yield(k)) {
+        std::uint64_t seq[2] = {
+            info->slot(0)->seq_.load(std::memory_order_acquire),
+            info->slot(1)->seq_.load(std::memory_order_acquire)
+        };
+        std::size_t first = ((seq[0] >> 1) >= (seq[1] >> 1)) ? 0 : 1;
+        for (std::size_t n = 0; n < 2; ++n) {
+            auto i = first ^ n;
+            if ((seq[i] & 1) || (seq[i] == 0)) continue; // being written, or empty
+            std::memcpy(data, info->data(i), info->size_);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (info->slot(i)->seq_.load(std::memory_order_relaxed) == seq[i]) {
+                return seq[i] >> 1;
+            }
+        }
+    }
+    return 0;
+}
+
+std::uint64_t latest_impl::wait(ipc::handle_t h, std::uint64_t ver, std::size_t tm) {
+    auto info = latest_of(h);
+    if (info == nullptr) return 0;
+    auto head = info->head();
+    std::uint64_t cur = ver;
+    if (!wait_for(info->waiter_, [head, ver, &cur] {
+        return (cur = head->pub_.load(std::memory_order_acquire)) == ver;
+    }, tm)) {
+        return 0;
+    }
+    return cur;
+}
+
+ipc::handle_t shard_impl::connect(char const * name, unsigned mode, std::size_t elem_max) {
+    if (name == nullptr || name[0] == '\0') {
+        ipc::error("fail: shard connect(%p)\n", name);
+        return nullptr;
+    }
+    auto info = mem::alloc<shard_info_t>(name, mode, elem_max);
+    if (info->table() == nullptr) {
+        mem::free(info);
+        return nullptr;
+    }
+    if (mode & receiver) {
+        info->table()->readers_.fetch_add(1, std::memory_order_release);
+        info->refresh();
+    }
+    return info;
+}
+
+void shard_impl::disconnect(ipc::handle_t h) {
+    auto info = shard_of(h);
+    if (info == nullptr) return;
+    info->unclaim();
+    info->close();
+    if (info->mode_ & receiver) {
+        info->table()->readers_.fetch_sub(1, std::memory_order_release);
+    }
+    mem::free(info);
+}
+
+std::size_t shard_impl::shard_count(ipc::handle_t h) {
+    auto info = shard_of(h);
+    if (info == nullptr) return 0;
+    auto mask = info->table()->shards_.load(std::memory_order_acquire);
+    std::size_t n = 0;
+    for (; mask != 0; mask &= (mask - 1)) ++n;
+    return n;
+}
+
+std::size_t shard_impl::recv_count(ipc::handle_t h) {
+    auto info = shard_of(h);
+    if (info == nullptr) return invalid_value;
+    return info->table()->readers_.load(std::memory_order_acquire);
+}
+
+bool shard_impl::send(ipc::handle_t h, void const * data, std::size_t size) {
+    auto info = shard_of(h);
+    if (info == nullptr || data == nullptr || size == 0) {
+        ipc::error("fail: shard send(%p, %p, %zd)\n", h, data, size);
+        return false;
+    }
+    if ((info->ring_ == nullptr) && !info->claim()) {
+        return false;
+    }
+    // the message is led by its sending time (for the ordered merge), gathered into the first fragment.
+    // The receivers wait on waiter_ for all the rings, so the ring doesn't wake anyone itself.
+    shard_time_t now = static_cast<shard_time_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 std::chrono::steady_clock::now().time_since_epoch()).count());
+    bool ret = shard_ring_t::send(info->ring_, data, size, &now, sizeof(now), false);
+    if (ret) info->waiter_.broadcast();
+    return ret;
+}
+
+buff_t shard_impl::recv(ipc::handle_t h, std::size_t tm, bool ordered) {
+    auto info = shard_of(h);
+    if (info == nullptr || !(info->mode_ & receiver)) {
+        ipc::error("fail: shard recv(%p), not a receiver\n", h);
+        return {};
+    }
+    while (1) {
+        info->refresh();
+        auto r = ordered ? info->oldest() : info->next();
+        if (r != nullptr) return shard_take(r);
+        if (tm == 0) return {};
+        if (!wait_for(info->waiter_, [info] { return info->idle(); }, tm)) {
+            return {};
+        }
+    }
+}
+
+ipc::handle_t part_impl::connect(char const * name, unsigned mode, std::size_t parts, std::size_t elem_max) {
+    if (name == nullptr || name[0] == '\0') {
+        ipc::error("fail: part connect(%p)\n", name);
+        return nullptr;
+    }
+    auto info = mem::alloc<part_info_t>(name, mode, elem_max);
+    if ((info->table() == nullptr) || !info->prepare(parts)) {
+        mem::free(info);
+        return nullptr;
+    }
+    if ((mode & receiver) && !info->join()) {
+        mem::free(info);
+        return nullptr;
+    }
+    return info;
+}
+
+void part_impl::disconnect(ipc::handle_t h) {
+    auto info = part_of(h);
+    if (info == nullptr) return;
+    info->leave();
+    info->close();
+    mem::free(info);
+}
+
+std::size_t part_impl::part_count(ipc::handle_t h) {
+    auto info = part_of(h);
+    if (info == nullptr) return 0;
+    return info->parts_;
+}
+
+std::size_t part_impl::recv_count(ipc::handle_t h) {
+    auto info = part_of(h);
+    if (info == nullptr) return invalid_value;
+    std::size_t n = 0;
+    for (auto mask = info->table()->members_.load(std::memory_order_acquire); mask != 0; mask &= (mask - 1)) ++n;
+    return n;
+}
+
+std::size_t part_impl::owned(ipc::handle_t h) {
+    auto info = part_of(h);
+    if (info == nullptr) return 0;
+    std::size_t n = 0;
+    for (auto mask = info->owned_; mask != 0; mask &= (mask - 1)) ++n;
+    return n;
+}
+
+bool part_impl::send(ipc::handle_t h, void const * key, std::size_t key_size, void const * data, std::size_t size) {
+    auto info = part_of(h);
+    if (info == nullptr || key == nullptr || key_size == 0 || data == nullptr || size == 0) {
+        ipc::error("fail: part send(%p, %p, %zd, %p, %zd)\n", h, key, key_size, data, size);
+        return false;
+    }
+    auto  i    = part_hash(key, key_size) % info->parts_;
+    auto& ring = info->senders_[i];
+    if ((ring == nullptr) && (ring = part_ring_t::connect(info->ring_name(i).c_str(), false, info->elem_max_)) == nullptr) {
+        return false;
+    }
+    /*
+     * The owner only polls a partition whose count has changed, so it's bumped when the ring is full,
+     * for the fragments pushed so far to be taken.
+     * A full partition having no owner is waited for, as it's being moved to another receiver,
+     * for move_wait rounds at most, unless the sender wouldn't wait (overflow::drop).
+    */
+    auto table = info->table();
+    if (!part_ring_t::send([info, table, i](auto conn, auto que, auto msg_id) {
+            return [info, table, i, conn, que, msg_id](int remain, void const * data, std::size_t size, std::uint8_t flags) {
+                auto push = [&] { return que->push(que, msg_id, remain, data, size, flags); };
+                if (push()) return true;
+                table->sent_[i].count_.fetch_add(1, std::memory_order_release);
+                info->waiter_.broadcast();
+                for (std::size_t n = 1; !push_for(conn, push, [] { return false; }); ++n) {
+                    if ((conn->overflow_ == overflow::drop) || (n >= part_impl::move_wait) ||
+                        (table->owners_[i].load(std::memory_order_acquire) != 0) ||
+                        (table->members_.load(std::memory_order_acquire) == 0)) return false;
+                }
+                return true;
+            };
+        }, ring, data, size)) {
+        return false;
+    }
+    table->sent_[i].count_.fetch_add(1, std::memory_order_release);
+    info->waiter_.broadcast();
+    return true;
+}
+
+buff_t part_impl::recv(ipc::handle_t h, std::size_t tm) {
+    auto info = part_of(h);
+    if (info == nullptr || info->id_ == invalid_value) {
+        ipc::error("fail: part recv(%p), not a receiver\n", h);
+        return {};
+    }
+    buff_t buff;
+    while (1) {
+        info->rebalance();
+        if (info->next(buff)) return buff;
+        if (tm == 0) return {};
+        // the kept partitions are checked again in a while, in case their senders have stopped
+        auto wt = (info->kept_ == 0) ? tm : (ipc::detail::min)(tm, std::size_t { default_timeut });
+        if (wait_for(info->waiter_, [info] { return info->idle(); }, wt)) continue;
+        if (wt == tm) return {};
+        if (tm != invalid_value) tm -= wt;
+    }
+}
 
 } // namespace ipc
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "pool_alloc.h"
+
+namespace ipc {
+
+/*
+ * A lock-free unbounded queue of many producers & one consumer (in one process),
+ * made of a linked list whose head is swapped by the producers.
+ * A push could be seen by the consumer only after its link is stored,
+ * so pop might return false for a moment while a push is in progress;
+ * the producer should notify the consumer after push returns.
+*/
+template <typename T>
+class mpsc_queue {
+    struct node_t {
+        std::atomic<node_t*> next_ { nullptr };
+        T                    value_ {};
+
+        node_t() = default;
+        explicit node_t(T&& value)
+            : value_(std::move(value)) {
+        }
+    };
+
+    std::atomic<node_t*> head_;  // the last pushed one
+    node_t*              tail_;  // a dummy, whose next is the first one to be popped
+
+public:
+    mpsc_queue()
+        : head_(mem::alloc<node_t>())
+        , tail_(head_.load(std::memory_order_relaxed)) {
+    }
+
+    mpsc_queue(mpsc_queue const &) = delete;
+    mpsc_queue& operator=(mpsc_queue const &) = delete;
+
+    ~mpsc_queue() {
+        while (tail_ != nullptr) {
+            auto next = tail_->next_.load(std::memory_order_relaxed);
+            mem::free(tail_);
+            tail_ = next;
+        }
+    }
+
+    void push(T value) {
+        auto n    = mem::alloc<node_t>(std::move(value));
+        auto prev = head_.exchange(n, std::memory_order_acq_rel);
+        prev->next_.store(n, std::memory_order_release);
+    }
+
+    // the consumer only
+    bool empty() const {
+        return tail_->next_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // the consumer only
+    bool pop(T& value) {
+        auto next = tail_->next_.load(std::memory_order_acquire);
+        if (next == nullptr) return false;
+        value = std::move(next->value_);
+        mem::free(tail_);
+        tail_ = next; // becomes the dummy
+        return true;
+    }
+};
+
+} // namespace ipc
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <thread>
+#include <cstddef>
+
+#include "log.h"
+
+#if defined(WIN64) || defined(_WIN64) || defined(__WIN64__) || \
+    defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__) || \
+    defined(WINCE) || defined(_WIN32_WCE)
+
+#include <Windows.h>
+
+namespace ipc {
+namespace detail {
+
+inline bool pin_thread(std::thread& t, std::size_t cpu) {
+    cpu %= (sizeof(DWORD_PTR) * 8);
+    if (::SetThreadAffinityMask(t.native_handle(), DWORD_PTR(1) << cpu) == 0) {
+        ipc::error("fail SetThreadAffinityMask[%d]: %zd\n", static_cast<int>(::GetLastError()), cpu);
+        return false;
+    }
+    return true;
+}
+
+} // namespace detail
+} // namespace ipc
+
+#else /*!WIN*/
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace ipc {
+namespace detail {
+
+inline bool pin_thread(std::thread& t, std::size_t cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % CPU_SETSIZE, &set);
+    int eno = ::pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+    if (eno != 0) {
+        ipc::error("fail pthread_setaffinity_np[%d]: %zd\n", eno, cpu);
+        return false;
+    }
+    return true;
+}
+
+} // namespace detail
+} // namespace ipc
+
+#endif/*!WIN*/
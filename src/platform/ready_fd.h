@@ -0,0 +1,234 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "def.h"
+#include "log.h"
+
+namespace ipc {
+namespace detail {
+
+/*
+ * The key of a readiness descriptor's address is the FNV-1a hash of its name (a channel & a slot of it),
+ * the same in every process. It goes byte by byte, so the key of a channel could be taken once,
+ * & be extended by the slots with no string built.
+*/
+inline std::uint64_t ready_key(char const * s, std::size_t n, std::uint64_t h = 14695981039346656037ull) noexcept {
+    for (std::size_t i = 0; i < n; ++i) {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 1099511628211ull;
+    }
+    return h;
+}
+
+} // namespace detail
+} // namespace ipc
+
+#if defined(WIN64) || defined(_WIN64) || defined(__WIN64__) || \
+    defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__) || \
+    defined(WINCE) || defined(_WIN32_WCE)
+
+namespace ipc {
+namespace detail {
+
+// there is no readiness descriptor on Windows, a receiver could only block in recv
+
+class ready_fd {
+public:
+    bool open (std::uint64_t) { return false; }
+    void close() {}
+    int  fd   () const noexcept { return -1; }
+    void drain() {}
+};
+
+class ready_signal {
+public:
+    void close() {}
+    bool signal(std::uint64_t) { return false; }
+};
+
+class ready_poll {
+public:
+    bool open  () { return false; }
+    void close () {}
+    bool add   (int, void*) { return false; }
+    void remove(int) {}
+    bool wait  (std::vector<void*>&, std::size_t) { return false; }
+};
+
+} // namespace detail
+} // namespace ipc
+
+#else /*!WIN*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <cstring>
+#include <cstdio>
+
+namespace ipc {
+namespace detail {
+
+/*
+ * The readiness descriptor of a receiver is a datagram socket bound to an abstract unix address,
+ * which is made of the address key (see ready_key).
+ * A sender signals it by sending an empty datagram to the address,
+ * so it needs no descriptor passing between the processes, & nothing is left in the file system.
+ * The address goes with the socket, even if its process dies.
+*/
+
+inline socklen_t ready_address(sockaddr_un& addr, std::uint64_t key) noexcept {
+    constexpr char prefix[] = "__IPC_READY__";
+    constexpr char digits[] = "0123456789abcdef";
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family  = AF_UNIX;
+    addr.sun_path[0] = '\0'; // the abstract namespace
+    auto p = addr.sun_path + 1;
+    std::memcpy(p, prefix, sizeof(prefix) - 1);
+    p += sizeof(prefix) - 1;
+    for (int i = 60; i >= 0; i -= 4) *p++ = digits[(key >> i) & 0xf];
+    return static_cast<socklen_t>(p - reinterpret_cast<char*>(&addr));
+}
+
+class ready_fd {
+    int fd_ = -1;
+
+public:
+    ~ready_fd() {
+        close();
+    }
+
+    // an address in use isn't an error, it tells the slot is taken
+    bool open(std::uint64_t key) {
+        close();
+        if ((fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+            ipc::error("fail socket[%d]: %016llx\n", errno, static_cast<unsigned long long>(key));
+            return false;
+        }
+        sockaddr_un addr;
+        auto len = ready_address(addr, key);
+        if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+            if (errno != EADDRINUSE) {
+                ipc::error("fail bind[%d]: %016llx\n", errno, static_cast<unsigned long long>(key));
+            }
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    int fd() const noexcept {
+        return fd_;
+    }
+
+    // takes all the signals, then the descriptor isn't readable until the next one
+    void drain() {
+        if (fd_ < 0) return;
+        char c;
+        while (::recv(fd_, &c, sizeof(c), MSG_DONTWAIT) >= 0) ;
+    }
+};
+
+class ready_signal {
+    int fd_ = -1;
+
+public:
+    ~ready_signal() {
+        close();
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    /*
+     * A receiver gone or a full socket (which is readable already) isn't an error,
+     * & the send never blocks nor raises SIGPIPE.
+    */
+    bool signal(std::uint64_t key) {
+        if ((fd_ < 0) && (fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+            ipc::error("fail socket[%d]: %016llx\n", errno, static_cast<unsigned long long>(key));
+            return false;
+        }
+        sockaddr_un addr;
+        auto len = ready_address(addr, key);
+        return ::sendto(fd_, "", 0, MSG_DONTWAIT | MSG_NOSIGNAL, reinterpret_cast<sockaddr*>(&addr), len) == 0;
+    }
+};
+
+// an epoll set of the readiness descriptors, each one is tagged with a pointer
+class ready_poll {
+    int fd_ = -1;
+
+public:
+    ~ready_poll() {
+        close();
+    }
+
+    bool open() {
+        close();
+        if ((fd_ = ::epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            ipc::error("fail epoll_create1[%d]\n", errno);
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool add(int fd, void* tag) {
+        epoll_event ev {};
+        ev.events   = EPOLLIN;
+        ev.data.ptr = tag;
+        if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ipc::error("fail epoll_ctl[%d]: add %d\n", errno, fd);
+            return false;
+        }
+        return true;
+    }
+
+    void remove(int fd) {
+        ::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    // returns false on timeout or failure, tags gets the ready ones
+    bool wait(std::vector<void*>& tags, std::size_t tm) {
+        epoll_event evs[64];
+        int n;
+        do {
+            n = ::epoll_wait(fd_, evs, static_cast<int>(sizeof(evs) / sizeof(evs[0])),
+                             (tm == invalid_value) ? -1 : static_cast<int>(tm));
+        } while ((n < 0) && (errno == EINTR));
+        if (n < 0) {
+            ipc::error("fail epoll_wait[%d]\n", errno);
+            return false;
+        }
+        for (int i = 0; i < n; ++i) tags.push_back(evs[i].data.ptr);
+        return n > 0;
+    }
+};
+
+} // namespace detail
+} // namespace ipc
+
+#endif/*!WIN*/
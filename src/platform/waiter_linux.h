@@ -6,9 +6,12 @@
 #include <semaphore.h>
 #include <errno.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <atomic>
-#include <tuple>
+#include <climits>
 
 #include "def.h"
 #include "log.h"
@@ -196,143 +199,119 @@ public:
 #pragma pop_macro("IPC_SEMAPHORE_FUNC_")
 };
 
-class waiter_helper {
-    mutex lock_;
-
-    std::atomic<unsigned> waiting_ { 0 };
-    long counter_ = 0;
-
+class futex_helper {
 public:
-    using handle_t = std::tuple<std::string, sem_helper::handle_t, sem_helper::handle_t>;
+    using word_t = std::atomic<unsigned>;
 
-    static handle_t invalid() noexcept {
-        return std::make_tuple(std::string{}, sem_helper::invalid(), sem_helper::invalid());
-    }
+    static_assert(sizeof(word_t) == sizeof(int), "a futex word must be 32 bits");
 
-    handle_t open_h(std::string && name) {
-        auto sem = sem_helper::open(("__WAITER_HELPER_SEM__" + name).c_str(), 0);
-        if (sem == sem_helper::invalid()) {
-            return invalid();
+    // returns false on timeout, a wake-up or a changed word returns true
+    static bool wait(word_t& word, unsigned expected, std::size_t tm = invalid_value) {
+        timespec ts, * pts = nullptr;
+        if (tm != invalid_value) {
+            ts.tv_sec  = static_cast<time_t>(tm / 1000);
+            ts.tv_nsec = static_cast<long>(tm % 1000) * 1000000; // nanoseconds
+            pts = &ts;
         }
-        auto han = sem_helper::open(("__WAITER_HELPER_HAN__" + name).c_str(), 0);
-        if (han == sem_helper::invalid()) {
-            return invalid();
+        // without FUTEX_PRIVATE_FLAG, the word might be waited in any process mapping it
+        if (::syscall(SYS_futex, &word, FUTEX_WAIT, expected, pts, nullptr, 0) != 0) {
+            if (errno == ETIMEDOUT) return false;
+            if (errno != EAGAIN && errno != EINTR) {
+                ipc::error("fail futex wait[%d]: tm = %zd\n", errno, tm);
+                return false;
+            }
         }
-        return std::make_tuple(std::move(name), sem, han);
-    }
-
-    void release_h(handle_t const & h) {
-        sem_helper::close(std::get<2>(h));
-        sem_helper::close(std::get<1>(h));
+        return true;
     }
 
-    void close_h(handle_t const & h) {
-        auto const & name = std::get<0>(h);
-        sem_helper::destroy(("__WAITER_HELPER_HAN__" + name).c_str());
-        sem_helper::destroy(("__WAITER_HELPER_SEM__" + name).c_str());
+    static bool wake(word_t& word, int count) {
+        if (::syscall(SYS_futex, &word, FUTEX_WAKE, count, nullptr, nullptr, 0) < 0) {
+            ipc::error("fail futex wake[%d]\n", errno);
+            return false;
+        }
+        return true;
     }
+};
 
-    bool open() {
-        return lock_.open();
-    }
+/*
+ * The waiters sleep on seq_, a notifier increases it & wakes them by one FUTEX_WAKE,
+ * so a broadcast costs a syscall however many waiters there are.
+ * A waiter reads seq_ before checking pred, so a notification after the check
+ * changes seq_, & FUTEX_WAIT returns at once instead of missing it.
+*/
+class waiter_helper {
+    std::atomic<unsigned> waiting_ { 0 };
+    futex_helper::word_t  seq_     { 0 };
 
-    void close() {
-        lock_.close();
+    bool wake(int count) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed) == 0) {
+            return true;
+        }
+        seq_.fetch_add(1, std::memory_order_release);
+        return futex_helper::wake(seq_, count);
     }
 
+public:
     template <typename F>
-    bool wait_if(handle_t const & h, F&& pred, std::size_t tm = invalid_value) {
-        waiting_.fetch_add(1, std::memory_order_release);
-        {
-            IPC_UNUSED_ auto guard = ipc::detail::unique_lock(lock_);
-            if (!std::forward<F>(pred)()) return true;
-            ++ counter_;
+    bool wait_if(F&& pred, std::size_t tm = invalid_value) {
+        waiting_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto seq = seq_.load(std::memory_order_acquire);
+        bool ret = true;
+        if (std::forward<F>(pred)()) {
+            ret = futex_helper::wait(seq_, seq, tm);
         }
-        bool ret = sem_helper::wait(std::get<1>(h), tm);
         waiting_.fetch_sub(1, std::memory_order_release);
-        ret = sem_helper::post(std::get<2>(h)) && ret;
         return ret;
     }
 
-    bool notify(handle_t const & h) {
-        std::atomic_thread_fence(std::memory_order_acq_rel);
-        if (waiting_.load(std::memory_order_relaxed) == 0) {
-            return true;
-        }
-        bool ret = true;
-        IPC_UNUSED_ auto guard = ipc::detail::unique_lock(lock_);
-        if (counter_ > 0) {
-            ret = sem_helper::post(std::get<1>(h));
-            -- counter_;
-            ret = ret && sem_helper::wait(std::get<2>(h), default_timeut);
-        }
-        return ret;
+    bool notify() {
+        return wake(1);
     }
 
-    bool broadcast(handle_t const & h) {
-        std::atomic_thread_fence(std::memory_order_acq_rel);
-        if (waiting_.load(std::memory_order_relaxed) == 0) {
-            return true;
-        }
-        bool ret = true;
-        IPC_UNUSED_ auto guard = ipc::detail::unique_lock(lock_);
-        if (counter_ > 0) {
-            for (long i = 0; i < counter_; ++i) {
-                ret = ret && sem_helper::post(std::get<1>(h));
-            }
-            do {
-                -- counter_;
-                ret = ret && sem_helper::wait(std::get<2>(h), default_timeut);
-            } while (counter_ > 0);
-        }
-        return ret;
+    bool broadcast() {
+        return wake(INT_MAX);
     }
 };
 
+/*
+ * The waiter lives in shared memory as it is, a zero-filled one is ready to use,
+ * & a handle is only the address of it in this process.
+*/
 class waiter {
     waiter_helper helper_;
-    std::atomic<unsigned> opened_ { 0 };
 
 public:
-    using handle_t = waiter_helper::handle_t;
+    using handle_t = waiter_helper*;
 
-    static handle_t invalid() noexcept {
-        return waiter_helper::invalid();
+    constexpr static handle_t invalid() noexcept {
+        return nullptr;
     }
 
     handle_t open(char const * name) {
         if (name == nullptr || name[0] == '\0') {
             return invalid();
         }
-        if ((opened_.fetch_add(1, std::memory_order_acq_rel) == 0) && !helper_.open()) {
-            return invalid();
-        }
-        return helper_.open_h(name);
+        return &helper_;
     }
 
-    void close(handle_t h) {
-        if (h == invalid()) return;
-        helper_.release_h(h);
-        if (opened_.fetch_sub(1, std::memory_order_release) == 1) {
-            helper_.close_h(h);
-            helper_.close();
-        }
-    }
+    void close(handle_t /*h*/) {}
 
     template <typename F>
     bool wait_if(handle_t h, F&& pred, std::size_t tm = invalid_value) {
         if (h == invalid()) return false;
-        return helper_.wait_if(h, std::forward<F>(pred), tm);
+        return h->wait_if(std::forward<F>(pred), tm);
     }
 
     void notify(handle_t h) {
         if (h == invalid()) return;
-        helper_.notify(h);
+        h->notify();
     }
 
     void broadcast(handle_t h) {
         if (h == invalid()) return;
-        helper_.broadcast(h);
+        h->broadcast();
     }
 };
 
@@ -6,6 +6,7 @@
 #include "prod_cons.h"
 
 #include "circ/elem_array.h"
+#include "circ/byte_array.h"
 
 namespace ipc {
 namespace policy {
@@ -15,9 +16,18 @@ struct choose;
 
 template <typename Flag>
 struct choose<circ::elem_array, Flag> {
+    using wr_t = Flag;
+
     template <std::size_t DataSize, std::size_t AlignSize>
     using elems_t = circ::elem_array<ipc::prod_cons_impl<Flag>, DataSize, AlignSize>;
 };
 
+template <typename Flag>
+struct choose<circ::byte_array, Flag> {
+    using wr_t = Flag;
+
+    using elems_t = circ::byte_array<Flag>;
+};
+
 } // namespace policy
 } // namespace ipc
@@ -0,0 +1,105 @@
+#include "ipc.h"
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+
+#include "pimpl.h"
+#include "log.h"
+
+#include "platform/ready_fd.h"
+
+namespace ipc {
+
+class poller::poller_ : public pimpl<poller_> {
+public:
+    struct entry_t {
+        int fd_;
+        bool (*arm_)(handle_t);
+    };
+
+    std::unordered_map<handle_t, entry_t> entries_;
+    std::vector<handle_t>                 added_; // returned by the next wait at once
+    detail::ready_poll                    poll_;
+    bool                                  opened_ = false;
+};
+
+poller::poller()
+    : p_(p_->make()) {
+}
+
+poller::poller(poller&& rhs)
+    : poller() {
+    swap(rhs);
+}
+
+poller::~poller() {
+    p_->clear();
+}
+
+void poller::swap(poller& rhs) {
+    std::swap(p_, rhs.p_);
+}
+
+poller& poller::operator=(poller rhs) {
+    swap(rhs);
+    return *this;
+}
+
+bool poller::add(handle_t h, int fd, bool (*arm)(handle_t)) {
+    if (h == nullptr || fd < 0 || arm == nullptr) {
+        ipc::error("fail: poller add(%p, %d)\n", h, fd);
+        return false;
+    }
+    auto p = impl(p_);
+    if (p->entries_.find(h) != p->entries_.end()) return true;
+    if (!p->opened_ && !(p->opened_ = p->poll_.open())) {
+        return false;
+    }
+    if (!p->poll_.add(fd, h)) {
+        return false;
+    }
+    p->entries_.emplace(h, poller_::entry_t { fd, arm });
+    p->added_.push_back(h);
+    return true;
+}
+
+void poller::remove(handle_t h) {
+    auto p  = impl(p_);
+    auto it = p->entries_.find(h);
+    if (it == p->entries_.end()) return;
+    p->poll_.remove(it->second.fd_);
+    p->entries_.erase(it);
+    for (auto i = p->added_.begin(); i != p->added_.end(); ++i) {
+        if (*i == h) {
+            p->added_.erase(i);
+            break;
+        }
+    }
+}
+
+std::size_t poller::size() const {
+    return impl(p_)->entries_.size();
+}
+
+std::vector<handle_t> poller::wait(std::size_t tm) {
+    auto p = impl(p_);
+    std::vector<handle_t> ret;
+    if (!p->added_.empty()) {
+        ret.swap(p->added_);
+        for (auto h : ret) p->entries_.at(h).arm_(h);
+        return ret;
+    }
+    if (p->entries_.empty()) return ret;
+    std::vector<void*> tags;
+    if (!p->poll_.wait(tags, tm)) return ret;
+    for (auto tag : tags) {
+        auto it = p->entries_.find(tag);
+        if (it == p->entries_.end()) continue;
+        it->second.arm_(tag);
+        ret.push_back(tag);
+    }
+    return ret;
+}
+
+} // namespace ipc
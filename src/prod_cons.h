@@ -4,8 +4,10 @@
 #include <utility>
 #include <cstring>
 #include <type_traits>
+#include <cstdint>
 
 #include "def.h"
+#include "log.h"
 
 #include "circ/elem_def.h"
 
@@ -15,9 +17,24 @@ namespace ipc {
 /// producer-consumer implementation
 ////////////////////////////////////////////////////////////////
 
+/*
+ * push_n & pop_n handle at most n elements at once, & return the count handled.
+ * f(i, p) is called for the i-th element, the index would be updated only once for all of them.
+ * On a multi-consumer ring, pop & pop_n may call f again (for the same i) if they failed to claim the elements,
+ * so f should only copy the element out, & the copy made by the last call is the one popped.
+*/
+
 template <typename Flag>
 struct prod_cons_impl;
 
+/*
+ * A force_push waiting for the oldest element to be written gives up after force_retry rounds,
+ * since its producer might have stalled (or died) in the middle of it.
+*/
+enum : unsigned {
+    force_retry = 1024
+};
+
 template <>
 struct prod_cons_impl<wr<relat::single, relat::single, trans::unicast>> {
 
@@ -34,9 +51,9 @@ struct prod_cons_impl<wr<relat::single, relat::single, trans::unicast>> {
     }
 
     template <typename W, typename F, typename E>
-    bool push(W* /*wrapper*/, F&& f, E* elems) {
-        auto cur_wt = circ::index_of(wt_.load(std::memory_order_relaxed));
-        if (cur_wt == circ::index_of(rd_.load(std::memory_order_acquire) - 1)) {
+    bool push(W* wrapper, F&& f, E* elems) {
+        auto cur_wt = wrapper->index_of(wt_.load(std::memory_order_relaxed));
+        if (cur_wt == wrapper->index_of(rd_.load(std::memory_order_acquire) - 1)) {
             return false; // full
         }
         std::forward<F>(f)(&(elems[cur_wt].data_));
@@ -44,44 +61,121 @@ struct prod_cons_impl<wr<relat::single, relat::single, trans::unicast>> {
         return true;
     }
 
+    // the consumer reads the elements in place, so the producer couldn't drop any of them
     template <typename W, typename F, typename E>
     bool force_push(W* wrapper, F&& f, E* elems) {
         return push(wrapper, std::forward<F>(f), elems);
     }
 
     template <typename W, typename F, typename E>
-    bool pop(W* /*wrapper*/, circ::u2_t& /*cur*/, F&& f, E* elems) {
-        auto cur_rd = circ::index_of(rd_.load(std::memory_order_relaxed));
-        if (cur_rd == circ::index_of(wt_.load(std::memory_order_acquire))) {
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        auto count  = free_of(wrapper, cur_wt, rd_.load(std::memory_order_acquire), n);
+        for (circ::u2_t i = 0; i < count; ++i) {
+            f(i, &(elems[wrapper->index_of(cur_wt + i)].data_));
+        }
+        if (count > 0) {
+            wt_.fetch_add(count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, circ::u2_t& /*cur*/, F&& f, E* elems) {
+        auto cur_rd = wrapper->index_of(rd_.load(std::memory_order_relaxed));
+        if (cur_rd == wrapper->index_of(wt_.load(std::memory_order_acquire))) {
             return false; // empty
         }
         std::forward<F>(f)(&(elems[cur_rd].data_));
         rd_.fetch_add(1, std::memory_order_release);
         return true;
     }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, circ::u2_t& /*cur*/, std::size_t n, F&& f, E* elems) {
+        auto cur_rd = rd_.load(std::memory_order_relaxed);
+        auto count  = used_of(wt_.load(std::memory_order_acquire), cur_rd, n);
+        for (circ::u2_t i = 0; i < count; ++i) {
+            f(i, &(elems[wrapper->index_of(cur_rd + i)].data_));
+        }
+        if (count > 0) {
+            rd_.fetch_add(count, std::memory_order_release);
+        }
+        return count;
+    }
+
+protected:
+    // one element is always kept empty for distinguishing full from empty
+    template <typename W>
+    static circ::u2_t free_of(W* wrapper, circ::u2_t wt, circ::u2_t rd, std::size_t n) noexcept {
+        circ::u2_t used = wt - rd, cap = static_cast<circ::u2_t>(wrapper->elem_max() - 1);
+        return (used >= cap) ? 0 : static_cast<circ::u2_t>((ipc::detail::min)(n, static_cast<std::size_t>(cap - used)));
+    }
+
+    static circ::u2_t used_of(circ::u2_t wt, circ::u2_t rd, std::size_t n) noexcept {
+        return static_cast<circ::u2_t>((ipc::detail::min)(n, static_cast<std::size_t>(static_cast<circ::u2_t>(wt - rd))));
+    }
 };
 
 template <>
 struct prod_cons_impl<wr<relat::single, relat::multi , trans::unicast>>
      : prod_cons_impl<wr<relat::single, relat::single, trans::unicast>> {
 
-    template <typename W, typename F, template <std::size_t, std::size_t> class E, std::size_t DS, std::size_t AS>
-    bool pop(W* /*wrapper*/, circ::u2_t& /*cur*/, F&& f, E<DS, AS>* elems) {
-        byte_t buff[DS];
+    /*
+     * Drops the oldest elements until there is room.
+     * The consumers copy an element out (calling f) before claiming it by rd,
+     * so one copying a dropped element would fail the claim & retry.
+    */
+    template <typename W, typename F, typename E>
+    bool force_push(W* wrapper, F&& f, E* elems) {
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        for (unsigned k = 0;;) {
+            auto cur_rd = rd_.load(std::memory_order_acquire);
+            if (wrapper->index_of(cur_wt) != wrapper->index_of(cur_rd - 1)) {
+                break;
+            }
+            if (!rd_.compare_exchange_weak(cur_rd, cur_rd + 1, std::memory_order_acq_rel)) {
+                ipc::yield(k);
+            }
+        }
+        return push(wrapper, std::forward<F>(f), elems);
+    }
+
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, circ::u2_t& /*cur*/, F&& f, E* elems) {
+        byte_t buff[sizeof(E::data_)];
         for (unsigned k = 0;;) {
             auto cur_rd = rd_.load(std::memory_order_relaxed);
-            if (circ::index_of(cur_rd) ==
-                circ::index_of(wt_.load(std::memory_order_acquire))) {
+            if (wrapper->index_of(cur_rd) ==
+                wrapper->index_of(wt_.load(std::memory_order_acquire))) {
                 return false; // empty
             }
-            std::memcpy(buff, &(elems[circ::index_of(cur_rd)].data_), sizeof(buff));
+            std::memcpy(buff, &(elems[wrapper->index_of(cur_rd)].data_), sizeof(buff));
+            f(buff);
             if (rd_.compare_exchange_weak(cur_rd, cur_rd + 1, std::memory_order_release)) {
-                std::forward<F>(f)(buff);
                 return true;
             }
             ipc::yield(k);
         }
     }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, circ::u2_t& /*cur*/, std::size_t n, F&& f, E* elems) {
+        for (unsigned k = 0;;) {
+            auto cur_rd = rd_.load(std::memory_order_relaxed);
+            auto count  = used_of(wt_.load(std::memory_order_acquire), cur_rd, n);
+            if (count == 0) {
+                return 0; // empty
+            }
+            for (circ::u2_t i = 0; i < count; ++i) {
+                f(i, &(elems[wrapper->index_of(cur_rd + i)].data_));
+            }
+            if (rd_.compare_exchange_weak(cur_rd, cur_rd + count, std::memory_order_release)) {
+                return count;
+            }
+            ipc::yield(k);
+        }
+    }
 };
 
 template <>
@@ -99,12 +193,12 @@ struct prod_cons_impl<wr<relat::multi , relat::multi, trans::unicast>>
     alignas(circ::cache_line_size) std::atomic<circ::u2_t> ct_; // commit index
 
     template <typename W, typename F, typename E>
-    bool push(W* /*wrapper*/, F&& f, E* elems) {
+    bool push(W* wrapper, F&& f, E* elems) {
         circ::u2_t cur_ct, nxt_ct;
         for (unsigned k = 0;;) {
             cur_ct = ct_.load(std::memory_order_relaxed);
-            if (circ::index_of(nxt_ct = cur_ct + 1) ==
-                circ::index_of(rd_.load(std::memory_order_acquire))) {
+            if (wrapper->index_of(nxt_ct = cur_ct + 1) ==
+                wrapper->index_of(rd_.load(std::memory_order_acquire))) {
                 return false; // full
             }
             if (ct_.compare_exchange_weak(cur_ct, nxt_ct, std::memory_order_release)) {
@@ -112,42 +206,65 @@ struct prod_cons_impl<wr<relat::multi , relat::multi, trans::unicast>>
             }
             ipc::yield(k);
         }
-        auto* el = elems + circ::index_of(cur_ct);
+        auto* el = elems + wrapper->index_of(cur_ct);
         std::forward<F>(f)(&(el->data_));
         // set flag & try update wt
         el->f_ct_.store(~static_cast<flag_t>(cur_ct), std::memory_order_release);
-        while (1) {
-            auto cac_ct = el->f_ct_.load(std::memory_order_acquire);
-            if (cur_ct != wt_.load(std::memory_order_acquire)) {
-                return true;
-            }
-            if ((~cac_ct) != cur_ct) {
+        publish(wrapper, cur_ct, elems);
+        return true;
+    }
+
+    // drops the oldest committed elements until there is room, like the smu one
+    template <typename W, typename F, typename E>
+    bool force_push(W* wrapper, F&& f, E* elems) {
+        for (unsigned k = 0, n = 0;;) {
+            if (push(wrapper, f, elems)) {
                 return true;
             }
-            if (!el->f_ct_.compare_exchange_strong(cac_ct, 0, std::memory_order_relaxed)) {
-                return true;
+            auto cur_rd = rd_.load(std::memory_order_acquire);
+            if (cur_rd == wt_.load(std::memory_order_acquire)) {
+                // the oldest one hasn't been published, it may be still being written
+                publish(wrapper, cur_rd, elems);
+                if (++n >= force_retry) return false;
+                ipc::yield(k);
+                continue;
             }
-            wt_.store(nxt_ct, std::memory_order_release);
-            cur_ct = nxt_ct;
-            nxt_ct = cur_ct + 1;
-            el = elems + circ::index_of(cur_ct);
+            n = 0;
+            rd_.compare_exchange_weak(cur_rd, cur_rd + 1, std::memory_order_acq_rel);
         }
-        return true;
     }
 
     template <typename W, typename F, typename E>
-    bool force_push(W* wrapper, F&& f, E* elems) {
-        return push(wrapper, std::forward<F>(f), elems); /* TBD */
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        circ::u2_t cur_ct, count;
+        for (unsigned k = 0;;) {
+            cur_ct = ct_.load(std::memory_order_relaxed);
+            count  = free_of(wrapper, cur_ct, rd_.load(std::memory_order_acquire), n);
+            if (count == 0) {
+                return 0; // full
+            }
+            if (ct_.compare_exchange_weak(cur_ct, cur_ct + count, std::memory_order_release)) {
+                break;
+            }
+            ipc::yield(k);
+        }
+        for (circ::u2_t i = 0; i < count; ++i) {
+            auto* el = elems + wrapper->index_of(cur_ct + i);
+            f(i, &(el->data_));
+            el->f_ct_.store(~static_cast<flag_t>(cur_ct + i), std::memory_order_release);
+        }
+        publish(wrapper, cur_ct, elems);
+        return count;
     }
 
-    template <typename W, typename F, template <std::size_t, std::size_t> class E, std::size_t DS, std::size_t AS>
-    bool pop(W* /*wrapper*/, circ::u2_t& /*cur*/, F&& f, E<DS, AS>* elems) {
-        byte_t buff[DS];
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, circ::u2_t& /*cur*/, F&& f, E* elems) {
+        byte_t buff[sizeof(E::data_)];
         for (unsigned k = 0;;) {
             auto cur_rd = rd_.load(std::memory_order_relaxed);
             auto cur_wt = wt_.load(std::memory_order_acquire);
-            auto id_rd  = circ::index_of(cur_rd);
-            auto id_wt  = circ::index_of(cur_wt);
+            auto id_rd  = wrapper->index_of(cur_rd);
+            auto id_wt  = wrapper->index_of(cur_wt);
             if (id_rd == id_wt) {
                 auto* el = elems + id_wt;
                 auto cac_ct = el->f_ct_.load(std::memory_order_acquire);
@@ -160,131 +277,498 @@ struct prod_cons_impl<wr<relat::multi , relat::multi, trans::unicast>>
                 k = 0;
             }
             else {
-                std::memcpy(buff, &(elems[circ::index_of(cur_rd)].data_), sizeof(buff));
+                std::memcpy(buff, &(elems[wrapper->index_of(cur_rd)].data_), sizeof(buff));
+                f(buff);
                 if (rd_.compare_exchange_weak(cur_rd, cur_rd + 1, std::memory_order_release)) {
-                    std::forward<F>(f)(buff);
                     return true;
                 }
                 ipc::yield(k);
             }
         }
     }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, circ::u2_t& /*cur*/, std::size_t n, F&& f, E* elems) {
+        for (unsigned k = 0;;) {
+            auto cur_rd = rd_.load(std::memory_order_relaxed);
+            auto cur_wt = wt_.load(std::memory_order_acquire);
+            auto id_wt  = wrapper->index_of(cur_wt);
+            if (wrapper->index_of(cur_rd) == id_wt) {
+                auto* el = elems + id_wt;
+                auto cac_ct = el->f_ct_.load(std::memory_order_acquire);
+                if ((~cac_ct) != cur_wt) {
+                    return 0; // empty
+                }
+                if (el->f_ct_.compare_exchange_weak(cac_ct, 0, std::memory_order_relaxed)) {
+                    wt_.store(cur_wt + 1, std::memory_order_release);
+                }
+                k = 0;
+            }
+            else {
+                auto count = used_of(cur_wt, cur_rd, n);
+                for (circ::u2_t i = 0; i < count; ++i) {
+                    f(i, &(elems[wrapper->index_of(cur_rd + i)].data_));
+                }
+                if (rd_.compare_exchange_weak(cur_rd, cur_rd + count, std::memory_order_release)) {
+                    return count;
+                }
+                ipc::yield(k);
+            }
+        }
+    }
+
+private:
+    // moves wt forward over the committed elements, starting from cur_ct
+    template <typename W, typename E>
+    void publish(W* wrapper, circ::u2_t cur_ct, E* elems) {
+        auto* el = elems + wrapper->index_of(cur_ct);
+        while (1) {
+            auto cac_ct = el->f_ct_.load(std::memory_order_acquire);
+            if (cur_ct != wt_.load(std::memory_order_acquire)) {
+                return;
+            }
+            if ((~cac_ct) != cur_ct) {
+                return;
+            }
+            if (!el->f_ct_.compare_exchange_strong(cac_ct, 0, std::memory_order_relaxed)) {
+                return;
+            }
+            wt_.store(++cur_ct, std::memory_order_release);
+            el = elems + wrapper->index_of(cur_ct);
+        }
+    }
 };
 
+/*
+ * Multi producers to multi consumers (unicast), in the style of Dmitry Vyukov's bounded MPMC queue.
+ * Each element carries its own sequence, so the other producers could still claim & write
+ * the elements after the one a producer is delayed on; the consumers stop at it though,
+ * as the elements are read in order.
+ * The sequence is stored relative to the lap of the index (index - index_of(index)),
+ * so a zero-filled ring is ready: it's the lap when the element is free for writing,
+ * lap + 1 after it has been written, & lap + elem_max after it has been read.
+*/
 template <>
-struct prod_cons_impl<wr<relat::single, relat::multi, trans::broadcast>> {
-
-    using rc_t = std::size_t;
+struct prod_cons_impl<wr_slot> {
 
     template <std::size_t DataSize, std::size_t AlignSize>
     struct elem_t {
         std::aligned_storage_t<DataSize, AlignSize> data_ {};
-        std::atomic<rc_t> rc_ { 0 }; // read-counter
+        std::atomic<circ::u2_t> seq_ { 0 };
     };
 
     alignas(circ::cache_line_size) std::atomic<circ::u2_t> wt_; // write index
+    alignas(circ::cache_line_size) std::atomic<circ::u2_t> rd_; // read index
 
-    circ::u2_t cursor() const noexcept {
-        return wt_.load(std::memory_order_acquire);
+    constexpr circ::u2_t cursor() const noexcept {
+        return 0;
     }
 
     template <typename W, typename F, typename E>
     bool push(W* wrapper, F&& f, E* elems) {
-        auto cc = wrapper->conn_count(std::memory_order_relaxed);
-        if (cc == 0) return false; // no reader
-        auto* el = elems + circ::index_of(wt_.load(std::memory_order_acquire));
-        // check all consumers have finished reading this element
-        rc_t expected = 0;
-        if (!el->rc_.compare_exchange_strong(
-                    expected, static_cast<rc_t>(cc), std::memory_order_acq_rel)) {
-            return false; // full
-        }
-        std::forward<F>(f)(&(el->data_));
-        wt_.fetch_add(1, std::memory_order_release);
-        return true;
+        return push_n(wrapper, 1, [&f](std::size_t, void* p) { f(p); }, elems) != 0;
     }
 
+    // a producer drops the oldest element by reading it itself
     template <typename W, typename F, typename E>
     bool force_push(W* wrapper, F&& f, E* elems) {
-        auto cc = wrapper->conn_count(std::memory_order_relaxed);
-        if (cc == 0) return false;      // no reader
-        cc = wrapper->disconnect() - 1; // disconnect a reader
-        if (cc == 0) return false;      // no reader
-        auto* el = elems + circ::index_of(wt_.load(std::memory_order_acquire));
-        // reset reading flag
-        el->rc_.store(static_cast<rc_t>(cc), std::memory_order_relaxed);
-        std::forward<F>(f)(&(el->data_));
-        wt_.fetch_add(1, std::memory_order_release);
-        return true;
+        for (unsigned k = 0, n = 0;;) {
+            if (push(wrapper, f, elems)) {
+                return true;
+            }
+            circ::u2_t cur = 0;
+            if (pop(wrapper, cur, [](void*) {}, elems)) {
+                n = 0;
+                continue;
+            }
+            // the oldest one is still being written
+            if (++n >= force_retry) return false;
+            ipc::yield(k);
+        }
     }
 
+    // the elements are claimed by one CAS on wt if all of them are free
     template <typename W, typename F, typename E>
-    bool pop(W* /*wrapper*/, circ::u2_t& cur, F&& f, E* elems) {
-        if (cur == cursor()) return false; // acquire
-        auto* el = elems + circ::index_of(cur++);
-        std::forward<F>(f)(&(el->data_));
-        for (unsigned k = 0;;) {
-            rc_t cur_rc = el->rc_.load(std::memory_order_acquire);
-            if (cur_rc == 0) {
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        circ::u2_t cur_wt, count;
+        for (unsigned k = 0;; ipc::yield(k)) {
+            cur_wt = wt_.load(std::memory_order_relaxed);
+            count  = ready_of(wrapper, cur_wt, 0, n, elems);
+            if (count == 0) {
+                auto dis = static_cast<std::int32_t>(seq_of(elems, wrapper, cur_wt) - lap_of(wrapper, cur_wt));
+                if (dis < 0) return 0; // full
+                continue;              // another producer has claimed it
+            }
+            if (wt_.compare_exchange_weak(cur_wt, cur_wt + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        for (circ::u2_t i = 0; i < count; ++i) {
+            auto* el = elems + wrapper->index_of(cur_wt + i);
+            f(i, &(el->data_));
+            el->seq_.store(lap_of(wrapper, cur_wt + i) + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, circ::u2_t& cur, F&& f, E* elems) {
+        return pop_n(wrapper, cur, 1, [&f](std::size_t, void* p) { f(p); }, elems) != 0;
+    }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, circ::u2_t& /*cur*/, std::size_t n, F&& f, E* elems) {
+        circ::u2_t cur_rd, count;
+        for (unsigned k = 0;; ipc::yield(k)) {
+            cur_rd = rd_.load(std::memory_order_relaxed);
+            count  = ready_of(wrapper, cur_rd, 1, n, elems);
+            if (count == 0) {
+                auto dis = static_cast<std::int32_t>(seq_of(elems, wrapper, cur_rd) - (lap_of(wrapper, cur_rd) + 1));
+                if (dis < 0) return 0; // empty
+                continue;              // another consumer has claimed it
+            }
+            if (rd_.compare_exchange_weak(cur_rd, cur_rd + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        // the claimed elements are read in place, then given back to the producers of the next lap
+        for (circ::u2_t i = 0; i < count; ++i) {
+            auto* el = elems + wrapper->index_of(cur_rd + i);
+            f(i, &(el->data_));
+            el->seq_.store(lap_of(wrapper, cur_rd + i) + wrapper->elem_max(), std::memory_order_release);
+        }
+        return count;
+    }
+
+private:
+    template <typename W>
+    static circ::u2_t lap_of(W* wrapper, circ::u2_t idx) noexcept {
+        return idx - static_cast<circ::u2_t>(wrapper->index_of(idx));
+    }
+
+    template <typename E, typename W>
+    static circ::u2_t seq_of(E* elems, W* wrapper, circ::u2_t idx) noexcept {
+        return elems[wrapper->index_of(idx)].seq_.load(std::memory_order_acquire);
+    }
+
+    // the count of the elements from idx whose sequences are lap + off, at most n
+    template <typename W, typename E>
+    static circ::u2_t ready_of(W* wrapper, circ::u2_t idx, circ::u2_t off, std::size_t n, E* elems) noexcept {
+        auto lim = static_cast<circ::u2_t>((ipc::detail::min)(n, static_cast<std::size_t>(wrapper->elem_max())));
+        circ::u2_t count = 0;
+        while ((count < lim) && (seq_of(elems, wrapper, idx + count) == lap_of(wrapper, idx + count) + off)) {
+            ++count;
+        }
+        return count;
+    }
+};
+
+/*
+ * The reader registry of the broadcast policies (smb & mmb), see circ::reader_bits.
+ * A producer facing a full ring evicts exactly the readers lagging on it,
+ * which are disconnected until they notice the overrun & rejoin from the newest element.
+ *
+ * The high half of an element's read-counter is the sequence (index + 1) of the element,
+ * which is set before the data is written, so a reader would find an overwritten element after copying it.
+*/
+class broadcast_readers : public circ::reader_bits<circ::u2_t> {
+public:
+    struct cursor_t {
+        circ::u2_t  rd_;
+        circ::u2_t  id_;   // the reader's bit, reader_max if the reader isn't registered
+        std::size_t lost_; // the elements skipped by being overrun
+
+        friend bool operator==(cursor_t const & a, cursor_t const & b) noexcept {
+            return a.rd_ == b.rd_;
+        }
+    };
+
+protected:
+    using rc_t = std::uint64_t;
+
+    constexpr static circ::u2_t seq_of(circ::u2_t idx) noexcept {
+        return idx + 1;
+    }
+
+    constexpr static circ::u2_t seq_of_rc(rc_t rc) noexcept {
+        return static_cast<circ::u2_t>(rc >> 32);
+    }
+
+    constexpr static mask_t mask_of(rc_t rc) noexcept {
+        return static_cast<mask_t>(rc);
+    }
+
+    constexpr static rc_t make_rc(circ::u2_t idx, mask_t mask) noexcept {
+        return (static_cast<rc_t>(seq_of(idx)) << 32) | mask;
+    }
+
+    template <typename W>
+    void evict(W* wrapper, mask_t bits) {
+        for (auto hit = reader_bits::evict(bits); hit != 0; hit &= hit - 1) wrapper->disconnect();
+    }
+
+    // an evicted (or a new) reader takes its bit back, & reads from the returned index
+    template <typename W>
+    circ::u2_t rejoin(W* wrapper, circ::u2_t id, std::atomic<circ::u2_t> const & wt) {
+        auto cur_wt = wt.load(std::memory_order_acquire);
+        // counted before being live, so an eviction at once wouldn't take the count below zero
+        wrapper->connect();
+        if (!reader_bits::rejoin(id, cur_wt)) wrapper->disconnect();
+        return cur_wt;
+    }
+
+    // the reader has been overrun, it jumps to the newest element
+    template <typename W>
+    void overrun(W* wrapper, cursor_t& cur, std::atomic<circ::u2_t> const & wt) {
+        auto cur_wt = (cur.id_ < reader_max) ? rejoin(wrapper, cur.id_, wt)
+                                             : wt.load(std::memory_order_acquire);
+        cur.lost_ += static_cast<circ::u2_t>(cur_wt - cur.rd_);
+        cur.rd_    = cur_wt;
+    }
+
+    /*
+     * Checks the element after copying it, & releases it if it's still the one at cur.
+     * from_ follows the reader once a lap, so the wrapping comparisons of it wouldn't go wrong.
+    */
+    template <typename W, typename E>
+    bool release(W* wrapper, cursor_t& cur, std::atomic<circ::u2_t> const & wt, E* el) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto cur_rc = el->rc_.load(std::memory_order_relaxed);
+        auto bit    = (cur.id_ < reader_max) ? (static_cast<rc_t>(1) << cur.id_) : 0;
+        for (;;) {
+            if (seq_of_rc(cur_rc) != seq_of(cur.rd_)) {
+                overrun(wrapper, cur, wt); // it has been overwritten
+                return false;
+            }
+            if (((cur_rc & bit) == 0) ||
+                el->rc_.compare_exchange_weak(cur_rc, cur_rc & ~bit, std::memory_order_release)) {
+                ++cur.rd_;
+                if ((bit != 0) && (wrapper->index_of(cur.rd_) == 0)) advance(cur.id_, cur.rd_);
                 return true;
             }
-            if (el->rc_.compare_exchange_weak(
-                        cur_rc, cur_rc - 1, std::memory_order_release)) {
+        }
+    }
+
+    /*
+     * Claims the element at cur_wt for the live readers, force evicts the ones lagging on it.
+     * Fails if there is no reader, the element is full, or another producer has claimed it.
+    */
+    template <typename W, typename E>
+    bool claim(W* wrapper, circ::u2_t cur_wt, E* el, bool force) {
+        auto cur_rc = el->rc_.load(std::memory_order_acquire);
+        for (;;) {
+            if (seq_of_rc(cur_rc) == seq_of(cur_wt)) return false;
+            auto lv = live();
+            if (lv == 0) return false; // no reader
+            auto lag = lagging(mask_of(cur_rc), seq_of_rc(cur_rc) - 1);
+            if (lag != 0) {
+                if (!force) return false; // full
+                evict(wrapper, lag);
+                continue;
+            }
+            if (el->rc_.compare_exchange_weak(cur_rc, make_rc(cur_wt, lv), std::memory_order_acq_rel)) {
+                // the new sequence is visible before the data, see release
+                std::atomic_thread_fence(std::memory_order_release);
                 return true;
             }
-            ipc::yield(k);
         }
     }
+
+public:
+    template <typename W>
+    cursor_t connect(W* wrapper, std::atomic<circ::u2_t> const & wt) {
+        auto id = claim_id();
+        if (id >= reader_max) {
+            ipc::error("fail: connect, there are too many readers (%u)\n", static_cast<unsigned>(reader_max));
+            return { wt.load(std::memory_order_acquire), reader_max, 0 };
+        }
+        return { rejoin(wrapper, id, wt), id, 0 };
+    }
+
+    template <typename W>
+    void disconnect(W* wrapper, cursor_t const & cur) {
+        if (cur.id_ >= reader_max) return;
+        // an evicted reader has been disconnected by force_push
+        if (leave(cur.id_)) wrapper->disconnect();
+    }
 };
 
 template <>
-struct prod_cons_impl<wr<relat::multi , relat::multi, trans::broadcast>> {
-
-    using rc_t   = std::uint64_t;
-    using flag_t = std::uint64_t;
+struct prod_cons_impl<wr<relat::single, relat::multi, trans::broadcast>> : broadcast_readers {
 
-    enum : rc_t {
-        rc_mask = 0x00000000ffffffffull,
-        rc_incr = 0x0000000100000000ull
+    template <std::size_t DataSize, std::size_t AlignSize>
+    struct elem_t {
+        std::aligned_storage_t<DataSize, AlignSize> data_ {};
+        std::atomic<rc_t> rc_ { 0 }; // read-counter, [sequence : readers' bits]
     };
 
+    alignas(circ::cache_line_size) std::atomic<circ::u2_t> wt_; // write index
+
+    cursor_t cursor() const noexcept {
+        return { wt_.load(std::memory_order_acquire), reader_max, 0 };
+    }
+
+    template <typename W, typename E>
+    cursor_t connect(W* wrapper, E* /*elems*/) {
+        return broadcast_readers::connect(wrapper, wt_);
+    }
+
+    template <typename W, typename F, typename E>
+    bool push(W* wrapper, F&& f, E* elems) {
+        return push(wrapper, std::forward<F>(f), elems, false);
+    }
+
+    template <typename W, typename F, typename E>
+    bool force_push(W* wrapper, F&& f, E* elems) {
+        return push(wrapper, std::forward<F>(f), elems, true);
+    }
+
+    // each element still needs its read-counter, but wt is updated once
+    template <typename W, typename F, typename E>
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        circ::u2_t count = 0;
+        for (; count < n; ++count) {
+            auto* el = elems + wrapper->index_of(cur_wt + count);
+            if (!claim(wrapper, cur_wt + count, el, false)) break;
+            f(count, &(el->data_));
+        }
+        if (count > 0) {
+            wt_.fetch_add(count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // an overrun reader goes on from the newest element, lost_ tells the skipped count
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, cursor_t& cur, F&& f, E* elems) {
+        for (;;) {
+            if (cur.rd_ == wt_.load(std::memory_order_acquire)) return false;
+            auto* el = elems + wrapper->index_of(cur.rd_);
+            if (seq_of_rc(el->rc_.load(std::memory_order_acquire)) != seq_of(cur.rd_)) {
+                overrun(wrapper, cur, wt_); // it has been overwritten
+                continue;
+            }
+            f(&(el->data_));
+            if (release(wrapper, cur, wt_, el)) return true;
+        }
+    }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, cursor_t& cur, std::size_t n, F&& f, E* elems) {
+        std::size_t count = 0;
+        while ((count < n) && pop(wrapper, cur, [&](void* p) { f(count, p); }, elems)) {
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    template <typename W, typename F, typename E>
+    bool push(W* wrapper, F&& f, E* elems, bool force) {
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        auto* el = elems + wrapper->index_of(cur_wt);
+        if (!claim(wrapper, cur_wt, el, force)) return false;
+        std::forward<F>(f)(&(el->data_));
+        wt_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+};
+
+template <>
+struct prod_cons_impl<wr<relat::multi , relat::multi, trans::broadcast>> : broadcast_readers {
+
+    using flag_t = std::uint64_t;
+
     template <std::size_t DataSize, std::size_t AlignSize>
     struct elem_t {
         std::aligned_storage_t<DataSize, AlignSize> data_ {};
-        std::atomic<rc_t  > rc_   { 0 }; // read-counter
+        std::atomic<rc_t  > rc_   { 0 }; // read-counter, [sequence : readers' bits]
         std::atomic<flag_t> f_ct_ { 0 }; // commit flag
     };
 
     alignas(circ::cache_line_size) std::atomic<circ::u2_t> ct_; // commit index
 
-    circ::u2_t cursor() const noexcept {
-        return ct_.load(std::memory_order_acquire);
+    cursor_t cursor() const noexcept {
+        return { ct_.load(std::memory_order_acquire), reader_max, 0 };
+    }
+
+    template <typename W, typename E>
+    cursor_t connect(W* wrapper, E* /*elems*/) {
+        return broadcast_readers::connect(wrapper, ct_);
     }
 
     template <typename W, typename F, typename E>
     bool push(W* wrapper, F&& f, E* elems) {
+        return push(wrapper, std::forward<F>(f), elems, false);
+    }
+
+    template <typename W, typename F, typename E>
+    bool force_push(W* wrapper, F&& f, E* elems) {
+        return push(wrapper, std::forward<F>(f), elems, true);
+    }
+
+    // an overrun reader goes on from the newest element, lost_ tells the skipped count
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, cursor_t& cur, F&& f, E* elems) {
+        for (;;) {
+            auto* el = elems + wrapper->index_of(cur.rd_);
+            auto dis = static_cast<std::int32_t>(seq_of_rc(el->rc_.load(std::memory_order_acquire)) - seq_of(cur.rd_));
+            if (dis > 0) { // it has been overwritten
+                overrun(wrapper, cur, ct_);
+                continue;
+            }
+            if ((dis < 0) || (el->f_ct_.load(std::memory_order_acquire) != ~static_cast<flag_t>(cur.rd_))) {
+                return false; // empty
+            }
+            f(&(el->data_));
+            if (release(wrapper, cur, ct_, el)) return true;
+        }
+    }
+
+    /*
+     * The producers claim an element by its read-counter before moving ct,
+     * so there isn't a single index update for a batch here, the elements are pushed one by one.
+    */
+    template <typename W, typename F, typename E>
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        std::size_t count = 0;
+        while ((count < n) && push(wrapper, [&](void* p) { f(count, p); }, elems)) {
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, cursor_t& cur, std::size_t n, F&& f, E* elems) {
+        std::size_t count = 0;
+        while ((count < n) && pop(wrapper, cur, [&](void* p) { f(count, p); }, elems)) {
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    template <typename W, typename F, typename E>
+    bool push(W* wrapper, F&& f, E* elems, bool force) {
         E* el;
         circ::u2_t cur_ct;
-        for (unsigned k = 0;;) {
-            auto cc = wrapper->conn_count(std::memory_order_relaxed);
-            if (cc == 0) {
-                return false; // no reader
-            }
-            el = elems + circ::index_of(cur_ct = ct_.load(std::memory_order_relaxed));
-            auto cur_rc = el->rc_.load(std::memory_order_acquire);
-            if (cur_rc & rc_mask) {
-                return false; // full
+        for (unsigned k = 0;; ipc::yield(k)) {
+            el = elems + wrapper->index_of(cur_ct = ct_.load(std::memory_order_acquire));
+            if (seq_of_rc(el->rc_.load(std::memory_order_acquire)) == seq_of(cur_ct)) {
+                continue; // another producer has claimed it, ct would move soon
             }
+            // the last lap of the element must have been committed
             auto cur_fl = el->f_ct_.load(std::memory_order_acquire);
-            if ((cur_fl != cur_ct) && cur_fl) {
+            if (cur_fl && (cur_fl != ~static_cast<flag_t>(static_cast<circ::u2_t>(cur_ct - wrapper->elem_max())))) {
+                if (force) continue;
                 return false; // full
             }
-            // (cur_rc & rc_mask) should == 0 here
-            if (el->rc_.compare_exchange_weak(
-                        cur_rc, static_cast<rc_t>(cc) | ((cur_rc & ~rc_mask) + rc_incr), std::memory_order_release)) {
-                break;
+            if (claim(wrapper, cur_ct, el, force)) break;
+            if (live() == 0) return false; // no reader
+            if (!force && (seq_of_rc(el->rc_.load(std::memory_order_acquire)) != seq_of(cur_ct))) {
+                return false; // full
             }
-            ipc::yield(k);
         }
         // only one thread/process would touch here at one time
         ct_.store(cur_ct + 1, std::memory_order_release);
@@ -293,58 +777,310 @@ struct prod_cons_impl<wr<relat::multi , relat::multi, trans::broadcast>> {
         el->f_ct_.store(~static_cast<flag_t>(cur_ct), std::memory_order_release);
         return true;
     }
+};
+
+/*
+ * Each reader owns a cursor on its own cache line in shm, & only writes there,
+ * the producer keeps a cached minimum of the cursors (gate_),
+ * which is refreshed only when the ring looks full.
+ * force_push drops the slowest readers, they would rejoin from the newest element at their next pop,
+ * & a reader copying the elements in place checks it hasn't been dropped meanwhile.
+*/
+template <>
+struct prod_cons_impl<wr_cursor> {
+
+    enum : circ::u2_t {
+        reader_max = 32
+    };
+
+    enum : circ::u2_t {
+        reader_free,
+        reader_used,
+        reader_dropped
+    };
+
+    struct alignas(circ::cache_line_size) reader_t {
+        std::atomic<circ::u2_t> rd_;    // read index
+        std::atomic<circ::u2_t> state_;
+    };
+
+    struct cursor_t {
+        circ::u2_t  rd_;
+        circ::u2_t  id_;   // index of readers_, reader_max if the reader isn't registered
+        std::size_t lost_; // the elements skipped by being dropped
+
+        friend bool operator==(cursor_t const & a, cursor_t const & b) noexcept {
+            return a.rd_ == b.rd_;
+        }
+    };
+
+    template <std::size_t DataSize, std::size_t AlignSize>
+    struct elem_t {
+        std::aligned_storage_t<DataSize, AlignSize> data_ {};
+    };
+
+    alignas(circ::cache_line_size) std::atomic<circ::u2_t> wt_; // write index
+    alignas(circ::cache_line_size) circ::u2_t gate_;            // the producer's cache of the minimum read index
+    reader_t readers_[reader_max];
+
+    cursor_t cursor() const noexcept {
+        return { wt_.load(std::memory_order_acquire), reader_max, 0 };
+    }
+
+    template <typename W, typename E>
+    cursor_t connect(W* wrapper, E* /*elems*/) {
+        for (circ::u2_t i = 0; i < reader_max; ++i) {
+            // claimed as a dropped one, which the producers ignore until rejoin has stored its rd_
+            auto expected = static_cast<circ::u2_t>(reader_free);
+            if (readers_[i].state_.compare_exchange_strong(expected, reader_dropped, std::memory_order_acq_rel)) {
+                cursor_t cur { 0, i, 0 };
+                rejoin(wrapper, cur);
+                cur.lost_ = 0;
+                return cur;
+            }
+        }
+        ipc::error("fail: connect, there are too many readers (%u)\n", static_cast<unsigned>(reader_max));
+        return cursor();
+    }
+
+    template <typename W>
+    void disconnect(W* wrapper, cursor_t cur) {
+        if (cur.id_ >= reader_max) return;
+        // a dropped reader has been disconnected by force_push
+        if (readers_[cur.id_].state_.exchange(reader_free, std::memory_order_acq_rel) == reader_used) {
+            wrapper->disconnect();
+        }
+    }
+
+    template <typename W, typename F, typename E>
+    bool push(W* wrapper, F&& f, E* elems) {
+        return push_n(wrapper, 1, [&f](std::size_t, void* p) { f(p); }, elems) != 0;
+    }
 
     template <typename W, typename F, typename E>
     bool force_push(W* wrapper, F&& f, E* elems) {
-        E* el;
-        circ::u2_t cur_ct;
-        auto cc = wrapper->conn_count(std::memory_order_relaxed);
-        if (cc == 0) return false; // no reader
-        wrapper->disconnect();     // disconnect a reader
-        for (unsigned k = 0;;) {
-            cc = wrapper->conn_count(std::memory_order_relaxed);
-            if (cc == 0) return false; // no reader
-            el = elems + circ::index_of(cur_ct = ct_.load(std::memory_order_relaxed));
-            auto cur_rc = el->rc_.load(std::memory_order_acquire);
-            el->rc_.store(static_cast<rc_t>(cc) | ((cur_rc & ~rc_mask) + rc_incr), std::memory_order_relaxed);
-            if (ct_.compare_exchange_weak(cur_ct, cur_ct + 1, std::memory_order_release)) {
-                break;
+        if (wrapper->conn_count(std::memory_order_relaxed) == 0) return false; // no reader
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        if (free_of(wrapper, cur_wt) == 0) {
+            // drop the readers which are blocking the producer
+            for (auto& r : readers_) {
+                if (r.state_.load(std::memory_order_acquire) != reader_used) continue;
+                if (static_cast<circ::u2_t>(cur_wt - r.rd_.load(std::memory_order_acquire)) < wrapper->elem_max()) continue;
+                auto expected = static_cast<circ::u2_t>(reader_used);
+                if (r.state_.compare_exchange_strong(expected, reader_dropped, std::memory_order_acq_rel)) {
+                    wrapper->disconnect();
+                }
             }
-            ipc::yield(k);
+            if (free_of(wrapper, cur_wt) == 0) return false;
+            // the dropping is visible before the data, see pop_n
+            std::atomic_thread_fence(std::memory_order_release);
         }
-        std::forward<F>(f)(&(el->data_));
-        // set flag & try update wt
-        el->f_ct_.store(~static_cast<flag_t>(cur_ct), std::memory_order_release);
+        f(&(elems[wrapper->index_of(cur_wt)].data_));
+        wt_.store(cur_wt + 1, std::memory_order_release);
         return true;
     }
 
-    template <typename W, typename F, typename E, std::size_t N>
-    bool pop(W* /*wrapper*/, circ::u2_t& cur, F&& f, E(& elems)[N]) {
-        auto* el = elems + circ::index_of(cur);
-        auto cur_fl = el->f_ct_.load(std::memory_order_acquire);
-        if (cur_fl != ~static_cast<flag_t>(cur)) {
-            return false; // empty
+    template <typename W, typename F, typename E>
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        if (wrapper->conn_count(std::memory_order_relaxed) == 0) return 0; // no reader
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        auto count  = static_cast<circ::u2_t>((ipc::detail::min)(n, static_cast<std::size_t>(free_of(wrapper, cur_wt))));
+        for (circ::u2_t i = 0; i < count; ++i) {
+            f(i, &(elems[wrapper->index_of(cur_wt + i)].data_));
         }
-        ++cur;
-        std::forward<F>(f)(&(el->data_));
-        for (unsigned k = 0;;) {
-            auto cur_rc = el->rc_.load(std::memory_order_acquire);
-            switch (cur_rc & rc_mask) {
-            case 0:
-                el->f_ct_.store(cur + N - 1, std::memory_order_release);
-                return true;
-            case 1:
-                el->f_ct_.store(cur + N - 1, std::memory_order_release);
-                [[fallthrough]];
-            default:
-                if (el->rc_.compare_exchange_weak(
-                            cur_rc, cur_rc + rc_incr - 1, std::memory_order_release)) {
+        if (count > 0) {
+            wt_.store(cur_wt + count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, cursor_t& cur, F&& f, E* elems) {
+        return pop_n(wrapper, cur, 1, [&f](std::size_t, void* p) { f(p); }, elems) != 0;
+    }
+
+    /*
+     * The elements are copied in place, then the copy is checked:
+     * if force_push has dropped this reader meanwhile, they might have been overwritten,
+     * so the copy is discarded & the reader rejoins from the newest element.
+    */
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, cursor_t& cur, std::size_t n, F&& f, E* elems) {
+        if (cur.id_ >= reader_max) return 0;
+        auto& r = readers_[cur.id_];
+        for (;;) {
+            if (r.state_.load(std::memory_order_acquire) != reader_used) {
+                rejoin(wrapper, cur);
+            }
+            auto count = static_cast<circ::u2_t>((ipc::detail::min)(n,
+                         static_cast<std::size_t>(static_cast<circ::u2_t>(wt_.load(std::memory_order_acquire) - cur.rd_))));
+            if (count == 0) return 0;
+            for (circ::u2_t i = 0; i < count; ++i) {
+                f(i, &(elems[wrapper->index_of(cur.rd_ + i)].data_));
+            }
+            // pairs with the fence in force_push
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((r.state_.load(std::memory_order_relaxed) == reader_used) &&
+                (static_cast<circ::u2_t>(wt_.load(std::memory_order_relaxed) - cur.rd_) <= wrapper->elem_max())) {
+                r.rd_.store(cur.rd_ += count, std::memory_order_release);
+                return count;
+            }
+            // the copy is discarded, & the reader rejoins from the newest element
+            rejoin(wrapper, cur);
+        }
+    }
+
+private:
+    /*
+     * A dropped (or a new) reader joins from the newest element, the skipped ones are counted in lost_.
+     * rd_ is stored before the reader is used, & loaded again after the fence,
+     * since a producer which hasn't seen it might have refreshed its gate up to the wt of then (see free_of).
+    */
+    template <typename W>
+    void rejoin(W* wrapper, cursor_t& cur) noexcept {
+        auto& r = readers_[cur.id_];
+        r.rd_.store(wt_.load(std::memory_order_acquire), std::memory_order_relaxed);
+        if (r.state_.load(std::memory_order_relaxed) == reader_dropped) {
+            // counted before being used, so dropping it at once wouldn't take the count below zero
+            wrapper->connect();
+            r.state_.store(reader_used, std::memory_order_release);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        r.rd_.store(cur_wt, std::memory_order_relaxed);
+        cur.lost_ += static_cast<circ::u2_t>(cur_wt - cur.rd_);
+        cur.rd_    = cur_wt;
+    }
+
+    // an element could be written until it would overwrite the one the slowest reader is on
+    template <typename W>
+    circ::u2_t free_of(W* wrapper, circ::u2_t cur_wt) noexcept {
+        auto cap = wrapper->elem_max();
+        if (static_cast<circ::u2_t>(cur_wt - gate_) < cap) {
+            return cap - static_cast<circ::u2_t>(cur_wt - gate_);
+        }
+        // refresh the gate, pairs with the fence in rejoin
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        circ::u2_t dis = 0;
+        for (auto& r : readers_) {
+            if (r.state_.load(std::memory_order_acquire) != reader_used) continue;
+            dis = (ipc::detail::max)(dis, static_cast<circ::u2_t>(cur_wt - r.rd_.load(std::memory_order_acquire)));
+        }
+        gate_ = cur_wt - dis;
+        return (dis < cap) ? (cap - dis) : 0;
+    }
+};
+
+/*
+ * Each element is guarded by a sequence (a seqlock),
+ * which is (index + 1) * 2 after the element has been written, & odd while it's being written.
+ * A reader copies the element out & checks the sequence again,
+ * if it has been overwritten, the reader jumps to the oldest element which is still there.
+*/
+template <>
+struct prod_cons_impl<wr_lossy> {
+
+    using seq_t = std::uint64_t;
+
+    struct cursor_t {
+        circ::u2_t  rd_;   // read index
+        std::size_t lost_; // count of the elements lost by being overrun
+
+        friend bool operator==(cursor_t const & a, cursor_t const & b) noexcept {
+            return a.rd_ == b.rd_;
+        }
+    };
+
+    template <std::size_t DataSize, std::size_t AlignSize>
+    struct elem_t {
+        std::atomic<seq_t> seq_ { 0 };
+        std::aligned_storage_t<DataSize, AlignSize> data_ {};
+    };
+
+    alignas(circ::cache_line_size) std::atomic<circ::u2_t> wt_; // write index
+
+    cursor_t cursor() const noexcept {
+        return { wt_.load(std::memory_order_acquire), 0 };
+    }
+
+    template <typename W, typename F, typename E>
+    bool push(W* wrapper, F&& f, E* elems) {
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        write(wrapper, cur_wt, std::forward<F>(f), elems);
+        wt_.store(cur_wt + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename W, typename F, typename E>
+    bool force_push(W* wrapper, F&& f, E* elems) {
+        return push(wrapper, std::forward<F>(f), elems);
+    }
+
+    template <typename W, typename F, typename E>
+    std::size_t push_n(W* wrapper, std::size_t n, F&& f, E* elems) {
+        auto cur_wt = wt_.load(std::memory_order_relaxed);
+        for (circ::u2_t i = 0; i < n; ++i) {
+            write(wrapper, cur_wt + i, [&f, i](void* p) { f(i, p); }, elems);
+        }
+        wt_.store(cur_wt + static_cast<circ::u2_t>(n), std::memory_order_release);
+        return n;
+    }
+
+    template <typename W, typename F, typename E>
+    bool pop(W* wrapper, cursor_t& cur, F&& f, E* elems) {
+        byte_t buff[sizeof(E::data_)];
+        while (1) {
+            auto* el = elems + wrapper->index_of(cur.rd_);
+            auto  s1 = el->seq_.load(std::memory_order_acquire);
+            auto  df = diff_of(s1, cur.rd_);
+            if ((df < 0) || ((df == 0) && (s1 & 1))) {
+                return false; // empty
+            }
+            if (df == 0) {
+                std::memcpy(buff, &(el->data_), sizeof(buff));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (el->seq_.load(std::memory_order_relaxed) == s1) {
+                    ++cur.rd_;
+                    std::forward<F>(f)(buff);
                     return true;
                 }
-                break;
             }
-            ipc::yield(k);
+            // overrun, skip to the oldest element
+            auto nxt_rd = wt_.load(std::memory_order_acquire) - (wrapper->elem_max() - 1);
+            if (static_cast<std::int32_t>(nxt_rd - cur.rd_) <= 0) {
+                nxt_rd = cur.rd_ + 1;
+            }
+            cur.lost_ += static_cast<circ::u2_t>(nxt_rd - cur.rd_);
+            cur.rd_    = nxt_rd;
+        }
+    }
+
+    template <typename W, typename F, typename E>
+    std::size_t pop_n(W* wrapper, cursor_t& cur, std::size_t n, F&& f, E* elems) {
+        std::size_t count = 0;
+        while ((count < n) && pop(wrapper, cur, [&](void* p) { f(count, p); }, elems)) {
+            ++count;
         }
+        return count;
+    }
+
+private:
+    constexpr static seq_t seq_of(circ::u2_t idx) noexcept {
+        return (static_cast<seq_t>(idx) + 1) << 1;
+    }
+
+    // the distance between the index of the sequence & idx
+    constexpr static std::int32_t diff_of(seq_t seq, circ::u2_t idx) noexcept {
+        return static_cast<std::int32_t>(static_cast<circ::u2_t>((seq >> 1) - 1) - idx);
+    }
+
+    template <typename W, typename F, typename E>
+    void write(W* wrapper, circ::u2_t idx, F&& f, E* elems) {
+        auto* el = elems + wrapper->index_of(idx);
+        el->seq_.store(seq_of(idx) | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::forward<F>(f)(&(el->data_));
+        el->seq_.store(seq_of(idx), std::memory_order_release);
     }
 };
 
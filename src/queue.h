@@ -15,6 +15,7 @@
 #include "log.h"
 #include "rw_lock.h"
 
+#include "circ/elem_def.h"
 #include "platform/detail.h"
 
 namespace ipc {
@@ -23,15 +24,35 @@ namespace detail {
 class queue_conn {
 protected:
     bool connected_ = false;
-    shm::handle elems_h_;
+    shm::handle em_h_, elems_h_;
+
+    /*
+     * The first one who opens the queue decides the ring capacity,
+     * the others would always follow the recorded one.
+    */
+    std::size_t agree_elem_max(char const * name, std::size_t elem_max) {
+        using em_t = std::atomic<std::size_t>;
+        if (!em_h_.acquire((std::string{ "__EM__" } + name).c_str(), sizeof(em_t))) {
+            return 0;
+        }
+        auto em = static_cast<em_t*>(em_h_.get());
+        std::size_t expected = 0;
+        if (em->compare_exchange_strong(expected, circ::elem_max_of(elem_max), std::memory_order_acq_rel)) {
+            return circ::elem_max_of(elem_max);
+        }
+        return expected;
+    }
 
     template <typename Elems>
-    Elems* open(char const * name) {
+    Elems* open(char const * name, std::size_t elem_max) {
         if (name == nullptr || name[0] == '\0') {
             ipc::error("fail open waiter: name is empty!\n");
             return nullptr;
         }
-        if (!elems_h_.acquire(name, sizeof(Elems))) {
+        if ((elem_max = agree_elem_max(name, elem_max)) == 0) {
+            return nullptr;
+        }
+        if (!elems_h_.acquire(name, Elems::size_of(elem_max))) {
             return nullptr;
         }
         auto elems = static_cast<Elems*>(elems_h_.get());
@@ -39,12 +60,13 @@ protected:
             ipc::error("fail acquire elems: %s\n", name);
             return nullptr;
         }
-        elems->init();
+        elems->init(elem_max);
         return elems;
     }
 
     void close() {
         elems_h_.release();
+        em_h_.release();
     }
 
 public:
@@ -64,20 +86,23 @@ public:
             // if it's already connected, just return false
             return {};
         }
+        auto cur = elems->connect_reader();
+        if (!elems->registered(cur)) {
+            return {}; // there are too many readers
+        }
         connected_ = true;
-        elems->connect();
-        return std::make_tuple(true, elems->cursor());
+        return std::make_tuple(true, cur);
     }
 
-    template <typename Elems>
-    bool disconnect(Elems* elems) {
+    template <typename Elems, typename Cursor>
+    bool disconnect(Elems* elems, Cursor const & cur) {
         if (elems == nullptr) return false;
         if (!connected_) {
             // if it's already disconnected, just return false
             return false;
         }
         connected_ = false;
-        elems->disconnect();
+        elems->disconnect_reader(cur);
         return true;
     }
 };
@@ -92,16 +117,16 @@ public:
 
 protected:
     elems_t * elems_ = nullptr;
-    decltype(std::declval<elems_t>().cursor()) cursor_ = 0;
+    decltype(std::declval<elems_t>().cursor()) cursor_ {};
 
 public:
     using base_t::base_t;
 
     queue_base() = default;
 
-    explicit queue_base(char const * name)
+    explicit queue_base(char const * name, std::size_t elem_max = default_elem_max)
         : queue_base() {
-        elems_ = open<elems_t>(name);
+        elems_ = open<elems_t>(name, elem_max);
     }
 
     /* not virtual */ ~queue_base() {
@@ -122,44 +147,75 @@ public:
     }
 
     bool disconnect() {
-        return base_t::disconnect(elems_);
+        return base_t::disconnect(elems_, cursor_);
     }
 
     std::size_t conn_count() const noexcept {
         return (elems_ == nullptr) ? invalid_value : elems_->conn_count();
     }
 
+    std::size_t elem_max() const noexcept {
+        return (elems_ == nullptr) ? 0 : elems_->elem_max();
+    }
+
     bool valid() const noexcept {
         return elems_ != nullptr;
     }
 
+    auto const & cursor() const noexcept {
+        return cursor_;
+    }
+
     bool empty() const noexcept {
         return (elems_ == nullptr) ? true : (cursor_ == elems_->cursor());
     }
 
-    template <typename T, typename... P>
-    auto push(P&&... params) {
+    // over(T const &) is given the old item of the slot, before it's overwritten
+    template <typename T, typename O, typename... P>
+    auto push(O&& over, P&&... params) {
         if (elems_ == nullptr) return false;
         return elems_->push([&](void* p) {
+            over(*static_cast<T const *>(p));
             ::new (p) T(std::forward<P>(params)...);
         });
     }
 
-    template <typename T, typename... P>
-    auto force_push(P&&... params) {
+    template <typename T, typename O, typename... P>
+    auto force_push(O&& over, P&&... params) {
         if (elems_ == nullptr) return false;
         return elems_->force_push([&](void* p) {
+            over(*static_cast<T const *>(p));
             ::new (p) T(std::forward<P>(params)...);
         });
     }
 
-    template <typename T>
-    bool pop(T& item) {
+    // copied(T&) is called on each copy, see prod_cons_impl for the copies which might be dropped
+    template <typename T, typename C>
+    bool pop(T& item, C&& copied) {
         if (elems_ == nullptr) {
             return false;
         }
-        return elems_->pop(&(this->cursor_), [&item](void* p) {
+        return elems_->pop(&(this->cursor_), [&item, &copied](void* p) {
             ::new (&item) T(std::move(*static_cast<T*>(p)));
+            copied(item);
+        });
+    }
+
+    // gen(i, p) constructs the i-th item at p
+    template <typename F>
+    std::size_t push_n(std::size_t n, F&& gen) {
+        if (elems_ == nullptr) return 0;
+        return elems_->push_n(n, std::forward<F>(gen));
+    }
+
+    template <typename T, typename C>
+    std::size_t pop_n(T* items, std::size_t n, C&& copied) {
+        if (elems_ == nullptr || items == nullptr) {
+            return 0;
+        }
+        return elems_->pop_n(&(this->cursor_), n, [items, &copied](std::size_t i, void* p) {
+            ::new (items + i) T(std::move(*static_cast<T*>(p)));
+            copied(i, items[i]);
         });
     }
 };
@@ -177,16 +233,123 @@ public:
 
     template <typename... P>
     auto push(P&&... params) {
-        return base_t::template push<T>(std::forward<P>(params)...);
+        return base_t::template push<T>([](T const &) {}, std::forward<P>(params)...);
     }
 
     template <typename... P>
     auto force_push(P&&... params) {
-        return base_t::template force_push<T>(std::forward<P>(params)...);
+        return base_t::template force_push<T>([](T const &) {}, std::forward<P>(params)...);
     }
 
     bool pop(T& item) {
-        return base_t::pop(item);
+        return base_t::pop(item, [](T&) {});
+    }
+
+    /*
+     * Pushes items constructed by gen(i) (returning a T) at most n, & returns the count pushed.
+     * The batch is published with one index update if the policy could.
+    */
+    template <typename F>
+    std::size_t push_n(std::size_t n, F&& gen) {
+        return push_n(n, [](T const &) {}, std::forward<F>(gen));
+    }
+
+    std::size_t pop_n(T* items, std::size_t n) {
+        return base_t::pop_n(items, n, [](std::size_t, T&) {});
+    }
+
+    /*
+     * The variants for the items referring to something outside the ring (e.g. a shared chunk):
+     * over(T const &) is given the old item of a slot before it's overwritten,
+     * & copied is called on each item copied out, including the ones the policy drops for retrying.
+    */
+    template <typename O, typename... P>
+    auto push_over(O&& over, P&&... params) {
+        return base_t::template push<T>(std::forward<O>(over), std::forward<P>(params)...);
+    }
+
+    template <typename O, typename... P>
+    auto force_push_over(O&& over, P&&... params) {
+        return base_t::template force_push<T>(std::forward<O>(over), std::forward<P>(params)...);
+    }
+
+    template <typename O, typename F>
+    std::size_t push_n(std::size_t n, O&& over, F&& gen) {
+        return base_t::push_n(n, [&over, &gen](std::size_t i, void* p) {
+            over(*static_cast<T const *>(p));
+            ::new (p) T(gen(i));
+        });
+    }
+
+    template <typename C>
+    bool pop(T& item, C&& copied) {
+        return base_t::pop(item, std::forward<C>(copied));
+    }
+
+    template <typename C>
+    std::size_t pop_n(T* items, std::size_t n, C&& copied) {
+        return base_t::pop_n(items, n, std::forward<C>(copied));
+    }
+};
+
+/*
+ * A queue of variable-length records,
+ * push writes size bytes through f(void*), pop reads them through f(void*, size).
+ * loan & commit split push, so the caller could fill the record in place,
+ * as pop_view & release split pop for reading it in place.
+*/
+template <typename Policy>
+class byte_queue : public detail::queue_base<typename Policy::elems_t> {
+    using base_t = detail::queue_base<typename Policy::elems_t>;
+
+public:
+    using base_t::base_t;
+
+    std::size_t max_size() const noexcept {
+        return (this->elems_ == nullptr) ? 0 : this->elems_->max_size();
+    }
+
+    template <typename F>
+    bool push(std::size_t size, F&& f) {
+        if (this->elems_ == nullptr) return false;
+        return this->elems_->push(size, std::forward<F>(f));
+    }
+
+    template <typename F>
+    bool force_push(std::size_t size, F&& f) {
+        if (this->elems_ == nullptr) return false;
+        return this->elems_->force_push(size, std::forward<F>(f));
+    }
+
+    void* loan(std::size_t size, typename base_t::elems_t::pos_t& pos) {
+        if (this->elems_ == nullptr) return nullptr;
+        return this->elems_->loan(size, pos);
+    }
+
+    void* force_loan(std::size_t size, typename base_t::elems_t::pos_t& pos) {
+        if (this->elems_ == nullptr) return nullptr;
+        return this->elems_->force_loan(size, pos);
+    }
+
+    void commit(typename base_t::elems_t::pos_t pos, bool cancel = false) {
+        if (this->elems_ == nullptr) return;
+        this->elems_->commit(pos, cancel);
+    }
+
+    template <typename F>
+    bool pop(F&& f) {
+        if (this->elems_ == nullptr) return false;
+        return this->elems_->pop(&(this->cursor_), std::forward<F>(f));
+    }
+
+    void* pop_view(std::size_t& size, typename base_t::elems_t::pos_t& pos) {
+        if (this->elems_ == nullptr) return nullptr;
+        return this->elems_->pop_view(&(this->cursor_), size, pos);
+    }
+
+    void release(typename base_t::elems_t::pos_t pos) {
+        if (this->elems_ == nullptr) return;
+        this->elems_->release(&(this->cursor_), pos);
     }
 };
 
@@ -0,0 +1,176 @@
+#include "scheduler.h"
+
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#include "pimpl.h"
+#include "log.h"
+
+namespace ipc {
+
+class scheduler::scheduler_ : public pimpl<scheduler_> {
+public:
+    struct chan_t {
+        buff_t (*try_recv_)(handle_t);
+        std::deque<recv_fn> recvs_;
+    };
+
+    struct send_t {
+        handle_t h_;
+        bool (*try_send_)(handle_t, void const *, std::size_t);
+        bool (*sendable_)(handle_t, std::size_t);
+        buff_t  data_;
+        send_fn fn_;
+    };
+
+    poller                                poller_;
+    std::unordered_map<handle_t, chan_t>  chans_;
+    std::vector<handle_t>                 checks_; // would be tried without waiting
+    std::deque<send_t>                    sends_;
+    std::size_t                           pending_ = 0;
+
+    // a completion might schedule (or remove) the operations, so the chan is found again each time
+    std::size_t complete_recv(handle_t h) {
+        std::size_t n = 0;
+        for (;;) {
+            auto it = chans_.find(h);
+            if ((it == chans_.end()) || it->second.recvs_.empty()) break;
+            auto buf = it->second.try_recv_(h);
+            if (buf.empty()) break;
+            auto fn = std::move(it->second.recvs_.front());
+            it->second.recvs_.pop_front();
+            -- pending_;
+            ++ n;
+            fn(std::move(buf));
+        }
+        return n;
+    }
+
+    std::size_t complete_send() {
+        std::size_t n = 0;
+        std::deque<send_t> sends;
+        sends.swap(sends_);
+        std::vector<handle_t> full; // the later sendings of a full channel keep the order
+        while (!sends.empty()) {
+            auto op = std::move(sends.front());
+            sends.pop_front();
+            if (std::find(full.begin(), full.end(), op.h_) != full.end()) {
+                sends_.push_back(std::move(op));
+                continue;
+            }
+            bool ok = op.try_send_(op.h_, op.data_.data(), op.data_.size());
+            // a full channel is retried the next turn, the ones never sending are completed with false
+            if (!ok && op.sendable_(op.h_, op.data_.size())) {
+                full.push_back(op.h_);
+                sends_.push_back(std::move(op));
+                continue;
+            }
+            -- pending_;
+            ++ n;
+            op.fn_(ok);
+        }
+        return n;
+    }
+};
+
+scheduler::scheduler()
+    : p_(p_->make()) {
+}
+
+scheduler::scheduler(scheduler&& rhs)
+    : scheduler() {
+    swap(rhs);
+}
+
+scheduler::~scheduler() {
+    p_->clear();
+}
+
+void scheduler::swap(scheduler& rhs) {
+    std::swap(p_, rhs.p_);
+}
+
+scheduler& scheduler::operator=(scheduler rhs) {
+    swap(rhs);
+    return *this;
+}
+
+bool scheduler::async_recv(handle_t h, int fd, bool (*arm)(handle_t), buff_t (*try_recv)(handle_t), recv_fn fn) {
+    if (!fn) {
+        ipc::error("fail: async_recv, the completion is empty\n");
+        return false;
+    }
+    auto p  = impl(p_);
+    auto it = p->chans_.find(h);
+    if (it == p->chans_.end()) {
+        if (!p->poller_.add(h, fd, arm)) return false;
+        it = p->chans_.emplace(h, scheduler_::chan_t { try_recv, {} }).first;
+    }
+    it->second.recvs_.push_back(std::move(fn));
+    p->checks_.push_back(h);
+    ++ p->pending_;
+    return true;
+}
+
+bool scheduler::async_send(handle_t h, bool (*try_send)(handle_t, void const *, std::size_t),
+                           bool (*sendable)(handle_t, std::size_t), buff_t data, send_fn fn) {
+    if (h == nullptr || data.empty() || !fn) {
+        ipc::error("fail: async_send(%p, %zd)\n", h, data.size());
+        return false;
+    }
+    auto p = impl(p_);
+    p->sends_.push_back({ h, try_send, sendable, std::move(data), std::move(fn) });
+    ++ p->pending_;
+    return true;
+}
+
+void scheduler::remove(handle_t h) {
+    auto p  = impl(p_);
+    auto it = p->chans_.find(h);
+    if (it != p->chans_.end()) {
+        p->pending_ -= it->second.recvs_.size();
+        p->chans_.erase(it);
+        p->poller_.remove(h);
+    }
+    for (auto i = p->sends_.begin(); i != p->sends_.end();) {
+        if (i->h_ == h) {
+            i = p->sends_.erase(i);
+            -- p->pending_;
+        }
+        else ++i;
+    }
+}
+
+std::size_t scheduler::pending() const {
+    return impl(p_)->pending_;
+}
+
+std::size_t scheduler::run_once(std::size_t tm) {
+    auto p = impl(p_);
+    std::size_t n = p->complete_send();
+    std::vector<handle_t> hs;
+    hs.swap(p->checks_);
+    for (auto h : hs) n += p->complete_recv(h);
+    if ((n > 0) || (p->pending_ == 0)) return n;
+    // nothing is ready now, wait for the readers
+    if (!p->checks_.empty()) tm = 0;
+    else if (!p->sends_.empty()) tm = (std::min)(tm, std::size_t { 1 });
+    if (p->poller_.size() == 0) {
+        // only the sendings are pending
+        std::this_thread::sleep_for(std::chrono::milliseconds(tm));
+        return n;
+    }
+    for (auto h : p->poller_.wait(tm)) n += p->complete_recv(h);
+    return n;
+}
+
+void scheduler::run() {
+    while (pending() > 0) run_once();
+}
+
+} // namespace ipc
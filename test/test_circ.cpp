@@ -5,6 +5,8 @@
 #include <new>
 #include <vector>
 #include <unordered_map>
+#include <thread>
+#include <cstring>
 
 #include "queue.h"
 #include "prod_cons.h"
@@ -23,9 +25,27 @@ struct msg_t {
 template <ipc::relat Rp, ipc::relat Rc, ipc::trans Ts>
 using pc_t = ipc::prod_cons_impl<ipc::wr<Rp, Rc, Ts>>;
 
-template <std::size_t DataSize, typename Policy>
-struct ea_t : public ipc::circ::elem_array<Policy, DataSize, 1> {
-    ea_t() { std::memset(this, 0, sizeof(ipc::circ::elem_array<Policy, DataSize, 1>)); }
+template <std::size_t DataSize, typename Policy, std::size_t ElemAlign = ipc::circ::cache_line_size>
+struct ea_t : public ipc::circ::elem_array<Policy, DataSize, 1, ElemAlign> {
+    using base_t = ipc::circ::elem_array<Policy, DataSize, 1, ElemAlign>;
+
+    enum : std::size_t {
+        alloc_size = base_t::size_of(ipc::default_elem_max)
+    };
+
+    // the elements are placed after the head, so ea_t could only be allocated on heap
+    static void* operator new(std::size_t) {
+        return ::operator new(alloc_size, std::align_val_t { alignof(base_t) });
+    }
+
+    static void operator delete(void* p) {
+        ::operator delete(p, std::align_val_t { alignof(base_t) });
+    }
+
+    ea_t() {
+        std::memset(this, 0, alloc_size);
+        this->init(ipc::default_elem_max);
+    }
 };
 
 using cq_t = ea_t<
@@ -40,8 +60,8 @@ bool operator==(msg_t const & m1, msg_t const & m2) {
 
 } // internal-linkage
 
-template <std::size_t D, typename P>
-struct test_verify<ea_t<D, P>> {
+template <std::size_t D, typename P, std::size_t A>
+struct test_verify<ea_t<D, P, A>> {
     std::vector<std::unordered_map<int, std::vector<int>>> list_;
 
     test_verify(int M)
@@ -97,6 +117,12 @@ struct test_verify<pc_t<Rp, ipc::relat::multi, ipc::trans::unicast>> : test_veri
     }
 };
 
+template <>
+struct test_verify<ipc::prod_cons_impl<ipc::wr_slot>>
+     : test_verify<pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>> {
+    using test_verify<pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>>::test_verify;
+};
+
 template <typename P>
 struct quit_mode;
 
@@ -113,9 +139,17 @@ struct quit_mode<pc_t<Rp, Rc, ipc::trans::broadcast>> {
     };
 };
 
-template <std::size_t D, typename P>
-struct test_cq<ea_t<D, P>> {
-    using ca_t = ea_t<D, P>;
+template <>
+struct quit_mode<ipc::prod_cons_impl<ipc::wr_slot>>
+     : quit_mode<pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>> {};
+
+template <>
+struct quit_mode<ipc::prod_cons_impl<ipc::wr_cursor>>
+     : quit_mode<pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>> {};
+
+template <std::size_t D, typename P, std::size_t A>
+struct test_cq<ea_t<D, P, A>> {
+    using ca_t = ea_t<D, P, A>;
     using cn_t = decltype(std::declval<ca_t>().cursor());
 
     typename quit_mode<P>::type quit_ = false;
@@ -124,13 +158,11 @@ struct test_cq<ea_t<D, P>> {
     test_cq(ca_t* ca) : ca_(ca) {}
 
     cn_t connect() {
-        auto cur = ca_->cursor();
-        ca_->connect();
-        return cur;
+        return ca_->connect_reader();
     }
 
-    void disconnect(cn_t) {
-        ca_->disconnect();
+    void disconnect(cn_t cur) {
+        ca_->disconnect_reader(cur);
     }
 
     void disconnect(ca_t*) {
@@ -238,6 +270,15 @@ private slots:
     void test_prod_cons_1v3();
     void test_prod_cons_performance();
     void test_queue();
+    void test_elem_max();
+    void test_byte_queue();
+    void test_batch();
+    void test_layout_performance();
+    void test_cursor_broadcast();
+    void test_lossy_broadcast();
+    void test_evict_reader();
+    void test_force_unicast();
+    void test_slot_performance();
 } unit__;
 
 #include "test_circ.moc"
@@ -258,11 +299,11 @@ void Unit::test_inst() {
     std::cout << "cq_t::head_size  = " << cq_t::head_size  << std::endl;
     std::cout << "cq_t::data_size  = " << cq_t::data_size  << std::endl;
     std::cout << "cq_t::elem_size  = " << cq_t::elem_size  << std::endl;
-    std::cout << "cq_t::block_size = " << cq_t::block_size << std::endl;
+    std::cout << "cq_t::block_size = " << cq_t::block_size(ipc::default_elem_max) << std::endl;
 
     QCOMPARE(static_cast<std::size_t>(cq_t::data_size), sizeof(msg_t));
 
-    std::cout << "sizeof(ea_t<sizeof(msg_t)>) = " << sizeof(*cq__) << std::endl;
+    std::cout << "size_of(ea_t<sizeof(msg_t)>) = " << cq_t::size_of(ipc::default_elem_max) << std::endl;
 }
 
 template <int N, int M, bool V = true, int Loops = LoopCount>
@@ -271,78 +312,78 @@ void test_prod_cons() {
 }
 
 void Unit::test_prod_cons_1v1() {
-//    ea_t<
+//    auto el_arr_mmb = std::make_unique<ea_t<
 //        sizeof(msg_t),
 //        pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>
-//    > el_arr_mmb;
-//    benchmark_prod_cons<1, 1, LoopCount, void>(&el_arr_mmb);
-//    benchmark_prod_cons<2, 1, LoopCount, void>(&el_arr_mmb);
+//    >>();
+//    benchmark_prod_cons<1, 1, LoopCount, void>(el_arr_mmb.get());
+//    benchmark_prod_cons<2, 1, LoopCount, void>(el_arr_mmb.get());
 
-    ea_t<
+    auto el_arr_ssu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>
-    > el_arr_ssu;
-    benchmark_prod_cons<1, 1, LoopCount, cq_t>(&el_arr_ssu);
-    benchmark_prod_cons<1, 1, LoopCount, void>(&el_arr_ssu);
+    >>();
+    benchmark_prod_cons<1, 1, LoopCount, cq_t>(el_arr_ssu.get());
+    benchmark_prod_cons<1, 1, LoopCount, void>(el_arr_ssu.get());
 
-    ea_t<
+    auto el_arr_smu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast>
-    > el_arr_smu;
-    benchmark_prod_cons<1, 1, LoopCount, decltype(el_arr_smu)::policy_t>(&el_arr_smu);
-    benchmark_prod_cons<1, 1, LoopCount, void>(&el_arr_smu);
+    >>();
+    benchmark_prod_cons<1, 1, LoopCount, decltype(el_arr_smu)::element_type::policy_t>(el_arr_smu.get());
+    benchmark_prod_cons<1, 1, LoopCount, void>(el_arr_smu.get());
 
-    ea_t<
+    auto el_arr_mmu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>
-    > el_arr_mmu;
-    benchmark_prod_cons<1, 1, LoopCount, decltype(el_arr_mmu)::policy_t>(&el_arr_mmu);
-    benchmark_prod_cons<1, 1, LoopCount, void>(&el_arr_mmu);
+    >>();
+    benchmark_prod_cons<1, 1, LoopCount, decltype(el_arr_mmu)::element_type::policy_t>(el_arr_mmu.get());
+    benchmark_prod_cons<1, 1, LoopCount, void>(el_arr_mmu.get());
 
     test_prod_cons<1, 1>();
     test_prod_cons<1, 1, false>();
 
-    ea_t<
+    auto el_arr_mmb = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>
-    > el_arr_mmb;
-    benchmark_prod_cons<1, 1, LoopCount, cq_t>(&el_arr_mmb);
-    benchmark_prod_cons<1, 1, LoopCount, void>(&el_arr_mmb);
+    >>();
+    benchmark_prod_cons<1, 1, LoopCount, cq_t>(el_arr_mmb.get());
+    benchmark_prod_cons<1, 1, LoopCount, void>(el_arr_mmb.get());
 }
 
 void Unit::test_prod_cons_1v3() {
-    ea_t<
+    auto el_arr_smu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast>
-    > el_arr_smu;
-    benchmark_prod_cons<1, 3, LoopCount, decltype(el_arr_smu)::policy_t>(&el_arr_smu);
-    benchmark_prod_cons<1, 3, LoopCount, void>(&el_arr_smu);
+    >>();
+    benchmark_prod_cons<1, 3, LoopCount, decltype(el_arr_smu)::element_type::policy_t>(el_arr_smu.get());
+    benchmark_prod_cons<1, 3, LoopCount, void>(el_arr_smu.get());
 
-    ea_t<
+    auto el_arr_mmu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>
-    > el_arr_mmu;
-    benchmark_prod_cons<1, 3, LoopCount, decltype(el_arr_mmu)::policy_t>(&el_arr_mmu);
-    benchmark_prod_cons<1, 3, LoopCount, void>(&el_arr_mmu);
+    >>();
+    benchmark_prod_cons<1, 3, LoopCount, decltype(el_arr_mmu)::element_type::policy_t>(el_arr_mmu.get());
+    benchmark_prod_cons<1, 3, LoopCount, void>(el_arr_mmu.get());
 
     test_prod_cons<1, 3>();
     test_prod_cons<1, 3, false>();
 
-    ea_t<
+    auto el_arr_mmb = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>
-    > el_arr_mmb;
-    benchmark_prod_cons<1, 3, LoopCount, cq_t>(&el_arr_mmb);
-    benchmark_prod_cons<1, 3, LoopCount, void>(&el_arr_mmb);
+    >>();
+    benchmark_prod_cons<1, 3, LoopCount, cq_t>(el_arr_mmb.get());
+    benchmark_prod_cons<1, 3, LoopCount, void>(el_arr_mmb.get());
 }
 
 void Unit::test_prod_cons_performance() {
-    ea_t<
+    auto el_arr_smu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast>
-    > el_arr_smu;
+    >>();
     ipc::detail::static_for<8>([&el_arr_smu](auto index) {
-        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(&el_arr_smu);
+        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(el_arr_smu.get());
     });
 
     ipc::detail::static_for<8>([](auto index) {
@@ -350,32 +391,32 @@ void Unit::test_prod_cons_performance() {
     });
     test_prod_cons<1, 8>(); // test & verify
 
-    ea_t<
+    auto el_arr_mmu = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>
-    > el_arr_mmu;
+    >>();
     ipc::detail::static_for<8>([&el_arr_mmu](auto index) {
-        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(&el_arr_mmu);
+        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(el_arr_mmu.get());
     });
     ipc::detail::static_for<8>([&el_arr_mmu](auto index) {
-        benchmark_prod_cons<decltype(index)::value + 1, 1, LoopCount, void>(&el_arr_mmu);
+        benchmark_prod_cons<decltype(index)::value + 1, 1, LoopCount, void>(el_arr_mmu.get());
     });
     ipc::detail::static_for<8>([&el_arr_mmu](auto index) {
-        benchmark_prod_cons<decltype(index)::value + 1, decltype(index)::value + 1, LoopCount, void>(&el_arr_mmu);
+        benchmark_prod_cons<decltype(index)::value + 1, decltype(index)::value + 1, LoopCount, void>(el_arr_mmu.get());
     });
 
-    ea_t<
+    auto el_arr_mmb = std::make_unique<ea_t<
         sizeof(msg_t),
         pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>
-    > el_arr_mmb;
+    >>();
     ipc::detail::static_for<8>([&el_arr_mmb](auto index) {
-        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(&el_arr_mmb);
+        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(el_arr_mmb.get());
     });
     ipc::detail::static_for<8>([&el_arr_mmb](auto index) {
-        benchmark_prod_cons<decltype(index)::value + 1, 1, LoopCount, void>(&el_arr_mmb);
+        benchmark_prod_cons<decltype(index)::value + 1, 1, LoopCount, void>(el_arr_mmb.get());
     });
     ipc::detail::static_for<8>([&el_arr_mmb](auto index) {
-        benchmark_prod_cons<decltype(index)::value + 1, decltype(index)::value + 1, LoopCount, void>(&el_arr_mmb);
+        benchmark_prod_cons<decltype(index)::value + 1, decltype(index)::value + 1, LoopCount, void>(el_arr_mmb.get());
     });
 }
 
@@ -390,11 +431,558 @@ void Unit::test_queue() {
     msg_t msg {};
     QVERIFY(!queue.pop(msg));
     QCOMPARE(msg, (msg_t {}));
-    QVERIFY(sizeof(decltype(queue)::elems_t) <= sizeof(*cq__));
+    QVERIFY(decltype(queue)::elems_t::size_of(ipc::default_elem_max) <= cq_t::size_of(ipc::default_elem_max));
 
     ipc::detail::static_for<16>([](auto index) {
         benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount>((queue_t*)nullptr);
     });
 }
 
+void Unit::test_elem_max() {
+    QCOMPARE(ipc::circ::elem_max_of(0)      , static_cast<ipc::circ::u2_t>(ipc::circ::elem_max_min));
+    QCOMPARE(ipc::circ::elem_max_of(100)    , static_cast<ipc::circ::u2_t>(128));
+    QCOMPARE(ipc::circ::elem_max_of(1024)   , static_cast<ipc::circ::u2_t>(1024));
+    QCOMPARE(ipc::circ::elem_max_of(1u << 30), static_cast<ipc::circ::u2_t>(ipc::circ::elem_max_lim));
+
+    using queue_t = ipc::queue<msg_t, ipc::policy::choose<
+            ipc::circ::elem_array,
+            ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>
+    >>;
+    queue_t que1 { "test-ipc-elem-max", 1000 };
+    QCOMPARE(que1.elem_max(), static_cast<std::size_t>(1024));
+
+    // the capacity has been recorded by que1
+    queue_t que2 { "test-ipc-elem-max", 64 };
+    QCOMPARE(que2.elem_max(), static_cast<std::size_t>(1024));
+
+    // one element is always kept empty for distinguishing full from empty
+    for (int i = 0; i < 1023; ++i) {
+        QVERIFY(que1.push(msg_t { 0, i }));
+    }
+    QVERIFY(!que1.push(msg_t { 0, 1023 }));
+    for (int i = 0; i < 1023; ++i) {
+        msg_t msg {};
+        QVERIFY(que2.pop(msg));
+        QCOMPARE(msg, (msg_t { 0, i }));
+    }
+    msg_t msg {};
+    QVERIFY(!que2.pop(msg));
+}
+
+template <ipc::relat Rp, ipc::relat Rc, ipc::trans Ts>
+using bq_t = ipc::byte_queue<ipc::policy::choose<ipc::circ::byte_array, ipc::wr<Rp, Rc, Ts>>>;
+
+template <typename Queue>
+void test_byte_queue_mt(char const * name, int N, int M, bool broadcast) {
+    // each message is { producer id, sequence } with a payload of (sequence % 300) bytes
+    constexpr int Loops = LoopCount / 10;
+    int const total = Loops * N;
+    std::vector<std::thread> producers, consumers;
+    std::atomic_int popped { 0 };
+
+    for (int m = 0; m < M; ++m) {
+        consumers.emplace_back([&] {
+            Queue que { name, 64 };
+            que.connect();
+            std::vector<int> seqs(static_cast<std::size_t>(N), -1);
+            for (int count = 0; broadcast ? (count < total) : (popped.load() < total);) {
+                msg_t msg {};
+                std::size_t size = 0;
+                bool ok = true;
+                if (!que.pop([&](void* p, std::size_t s) {
+                    std::memcpy(&msg, p, sizeof(msg));
+                    size = s;
+                    for (std::size_t i = sizeof(msg); i < s; ++i) {
+                        ok = ok && (static_cast<ipc::byte_t*>(p)[i] == static_cast<ipc::byte_t>(msg.dat_));
+                    }
+                })) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                QVERIFY(ok);
+                QCOMPARE(size, sizeof(msg) + static_cast<std::size_t>(msg.dat_ % 300));
+                // the messages of one producer are always in order
+                QVERIFY(seqs[static_cast<std::size_t>(msg.pid_)] < msg.dat_);
+                seqs[static_cast<std::size_t>(msg.pid_)] = msg.dat_;
+                ++count;
+                popped.fetch_add(1, std::memory_order_relaxed);
+            }
+            que.disconnect();
+        });
+    }
+    Queue que { name, 64 };
+    while (que.conn_count() != static_cast<std::size_t>(M)) {
+        std::this_thread::yield();
+    }
+    for (int n = 0; n < N; ++n) {
+        producers.emplace_back([&, n] {
+            Queue que { name, 64 };
+            for (int i = 0; i < Loops; ++i) {
+                std::size_t size = sizeof(msg_t) + static_cast<std::size_t>(i % 300);
+                while (!que.push(size, [&](void* p) {
+                    msg_t msg { n, i };
+                    std::memcpy(p, &msg, sizeof(msg));
+                    std::memset(static_cast<ipc::byte_t*>(p) + sizeof(msg), i, size - sizeof(msg));
+                })) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    for (auto& t : consumers) t.join();
+    QCOMPARE(popped.load(), broadcast ? (total * M) : total);
+}
+
+void Unit::test_byte_queue() {
+    using queue_t = bq_t<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>;
+    // 8 units: a ring of 512 bytes
+    queue_t que { "test-ipc-byte-queue", 8 };
+    QCOMPARE(que.elem_max(), static_cast<std::size_t>(8));
+    QVERIFY(que.max_size() < 512);
+    QVERIFY(!que.push(que.max_size() + 1, [](void*) {}));
+
+    auto push = [&que](std::size_t size, int c) {
+        return que.push(size, [size, c](void* p) { std::memset(p, c, size); });
+    };
+    auto pop = [&que](std::size_t size, int c) {
+        bool ok = false;
+        return que.pop([&ok, size, c](void* p, std::size_t s) {
+            ok = (s == size);
+            for (std::size_t i = 0; ok && (i < s); ++i) {
+                ok = (static_cast<ipc::byte_t*>(p)[i] == static_cast<ipc::byte_t>(c));
+            }
+        }) && ok;
+    };
+
+    // the records are variable-length & the ring wraps around by padding
+    for (int i = 0; i < 100; ++i) {
+        std::size_t size = static_cast<std::size_t>(i * 37 % 150);
+        QVERIFY(push(size, i));
+        QVERIFY(push(10, i + 1));
+        QVERIFY(pop(size, i));
+        QVERIFY(pop(10, i + 1));
+        QVERIFY(!que.pop([](void*, std::size_t) {}));
+    }
+
+    // full
+    int n = 0;
+    while (push(40, n)) ++n;
+    QVERIFY(n > 0);
+    for (int i = 0; i < n; ++i) {
+        QVERIFY(pop(40, i));
+    }
+    // a record as large as the ring has to wait for the readers passing the padding
+    if (!push(que.max_size(), 'x')) {
+        QVERIFY(!que.pop([](void*, std::size_t) {}));
+        QVERIFY(push(que.max_size(), 'x'));
+    }
+    QVERIFY(pop(que.max_size(), 'x'));
+
+    // loaned records are published in order of reserving, a cancelled one is skipped
+    queue_t::elems_t::pos_t pos1, pos2;
+    auto p1 = que.loan(20, pos1);
+    auto p2 = que.loan(30, pos2);
+    QVERIFY(p1 != nullptr && p2 != nullptr);
+    std::memset(p2, 2, 30);
+    que.commit(pos2);
+    QVERIFY(!que.pop([](void*, std::size_t) {})); // waiting for pos1
+    std::memset(p1, 1, 20);
+    que.commit(pos1, true);
+    QVERIFY(pop(30, 2));
+    QVERIFY(!que.pop([](void*, std::size_t) {}));
+
+    // a viewed record isn't reclaimed before release
+    QVERIFY(push(que.max_size() / 2, 'v'));
+    std::size_t size = 0;
+    auto v = static_cast<ipc::byte_t*>(que.pop_view(size, pos1));
+    QVERIFY(v != nullptr);
+    QCOMPARE(size, que.max_size() / 2);
+    QVERIFY(!push(que.max_size(), 'x'));
+    QCOMPARE(v[0], static_cast<ipc::byte_t>('v'));
+    que.release(pos1);
+    QVERIFY(push(que.max_size(), 'x') || (!que.pop([](void*, std::size_t) {}) && push(que.max_size(), 'x')));
+    QVERIFY(pop(que.max_size(), 'x'));
+
+    test_byte_queue_mt<bq_t<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast  >>("test-ipc-byte-smu", 1, 4, false);
+    test_byte_queue_mt<bq_t<ipc::relat::multi , ipc::relat::multi, ipc::trans::unicast  >>("test-ipc-byte-mmu", 4, 4, false);
+    test_byte_queue_mt<bq_t<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>("test-ipc-byte-smb", 1, 4, true);
+    test_byte_queue_mt<bq_t<ipc::relat::multi , ipc::relat::multi, ipc::trans::broadcast>>("test-ipc-byte-mmb", 4, 4, true);
+}
+
+template <typename Policy>
+void test_batch_policy() {
+    auto ea = std::make_unique<ea_t<sizeof(msg_t), Policy>>();
+    auto cur = ea->connect_reader();
+
+    auto gen = [](int base) {
+        return [base](std::size_t i, void* p) {
+            ::new (p) msg_t { 0, base + static_cast<int>(i) };
+        };
+    };
+    std::vector<msg_t> msgs;
+    auto pop_batch = [&](std::size_t n) {
+        msgs.assign(n, msg_t {});
+        return ea->pop_n(&cur, n, [&](std::size_t i, void* p) {
+            msgs[i] = *static_cast<msg_t*>(p);
+        });
+    };
+
+    // a batch larger than the ring is cut to the free elements
+    auto pushed = ea->push_n(1000, gen(0));
+    QVERIFY(pushed > 0);
+    QVERIFY(pushed <= ipc::default_elem_max);
+    QCOMPARE(ea->push_n(1, gen(0)), std::size_t(0));
+
+    int next = 0;
+    std::size_t popped = 0;
+    while (popped < pushed) {
+        auto count = pop_batch(7);
+        QVERIFY(count > 0);
+        QVERIFY(count <= 7);
+        for (std::size_t i = 0; i < count; ++i) {
+            QCOMPARE(msgs[i].dat_, next++);
+        }
+        popped += count;
+    }
+    QCOMPARE(pop_batch(7), std::size_t(0));
+
+    // wrapping around the end of the ring
+    QCOMPARE(ea->push_n(100, gen(1000)), std::size_t(100));
+    QCOMPARE(pop_batch(200), std::size_t(100));
+    for (std::size_t i = 0; i < 100; ++i) {
+        QCOMPARE(msgs[i].dat_, 1000 + static_cast<int>(i));
+    }
+    ea->disconnect_reader(cur);
+}
+
+void Unit::test_batch() {
+    test_batch_policy<pc_t<ipc::relat::single, ipc::relat::single, ipc::trans::unicast  >>();
+    test_batch_policy<pc_t<ipc::relat::single, ipc::relat::multi , ipc::trans::unicast  >>();
+    test_batch_policy<pc_t<ipc::relat::multi , ipc::relat::multi , ipc::trans::unicast  >>();
+    test_batch_policy<pc_t<ipc::relat::single, ipc::relat::multi , ipc::trans::broadcast>>();
+    test_batch_policy<pc_t<ipc::relat::multi , ipc::relat::multi , ipc::trans::broadcast>>();
+    test_batch_policy<ipc::prod_cons_impl<ipc::wr_cursor>>();
+    test_batch_policy<ipc::prod_cons_impl<ipc::wr_slot>>();
+}
+
+/*
+ * The packed elements (ElemAlign = 1) against the cache-line aligned ones,
+ * under 1:N & N:N contention of the broadcast policies.
+*/
+template <typename Policy>
+void benchmark_layout() {
+    auto packed = std::make_unique<ea_t<sizeof(msg_t), Policy, 1>>();
+    auto padded = std::make_unique<ea_t<sizeof(msg_t), Policy>>();
+    std::cout << "packed elem_size = " << decltype(packed)::element_type::elem_size
+              << ", padded elem_size = " << decltype(padded)::element_type::elem_size << std::endl;
+    ipc::detail::static_for<4>([&](auto index) {
+        constexpr int M = (decltype(index)::value + 1) * 2;
+        benchmark_prod_cons<1, M, LoopCount, void>(packed.get());
+        benchmark_prod_cons<1, M, LoopCount, void>(padded.get());
+    });
+}
+
+void Unit::test_layout_performance() {
+    benchmark_layout<pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>();
+    benchmark_layout<pc_t<ipc::relat::multi , ipc::relat::multi, ipc::trans::broadcast>>();
+
+    auto packed = std::make_unique<ea_t<sizeof(msg_t), pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>, 1>>();
+    auto padded = std::make_unique<ea_t<sizeof(msg_t), pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>>>();
+    ipc::detail::static_for<4>([&](auto index) {
+        constexpr int N = (decltype(index)::value + 1) * 2;
+        benchmark_prod_cons<N, N, LoopCount, void>(packed.get());
+        benchmark_prod_cons<N, N, LoopCount, void>(padded.get());
+    });
+}
+
+void Unit::test_cursor_broadcast() {
+    using ca_t = ea_t<sizeof(msg_t), ipc::prod_cons_impl<ipc::wr_cursor>>;
+    {
+        auto ca = std::make_unique<ca_t>();
+        auto push = [&ca](int i) {
+            return ca->push([i](void* p) { ::new (p) msg_t { 0, i }; });
+        };
+        auto pop = [&ca](auto& cur, msg_t& msg) {
+            return ca->pop(&cur, [&msg](void* p) { msg = *static_cast<msg_t*>(p); });
+        };
+        QVERIFY(!push(0)); // no reader
+        auto c1 = ca->connect_reader();
+        auto c2 = ca->connect_reader();
+        QCOMPARE(ca->conn_count(), std::size_t(2));
+
+        // the ring is full when the slowest reader is a whole ring behind
+        int n = 0;
+        while (push(n)) ++n;
+        QCOMPARE(n, static_cast<int>(ipc::default_elem_max));
+        msg_t msg {};
+        for (int i = 0; i < n; ++i) {
+            QVERIFY(pop(c2, msg));
+            QCOMPARE(msg.dat_, i);
+        }
+        QVERIFY(!pop(c2, msg));
+        QVERIFY(!push(n)); // c1 is blocking
+
+        // drop c1, which rejoins from the newest element
+        QVERIFY(ca->force_push([n](void* p) { ::new (p) msg_t { 0, n }; }));
+        QCOMPARE(ca->conn_count(), std::size_t(1));
+        QVERIFY(pop(c2, msg));
+        QCOMPARE(msg.dat_, n);
+        QVERIFY(!pop(c1, msg));
+        QCOMPARE(ca->conn_count(), std::size_t(2));
+        QCOMPARE(c1.lost_, static_cast<std::size_t>(n + 1));
+        QCOMPARE(c2.lost_, std::size_t(0));
+        QVERIFY(push(n + 1));
+        QVERIFY(pop(c1, msg));
+        QCOMPARE(msg.dat_, n + 1);
+        QVERIFY(pop(c2, msg));
+        QCOMPARE(msg.dat_, n + 1);
+
+        // c1 is dropped while it's copying, so the copy is discarded
+        int k = n + 2;
+        for (; push(k); ++k) {
+            QVERIFY(pop(c2, msg));
+        }
+        QCOMPARE(k, n + 2 + n);
+        bool forced = false;
+        QVERIFY(!ca->pop(&c1, [&](void* p) {
+            msg = *static_cast<msg_t*>(p);
+            if (!forced) forced = ca->force_push([k](void* q) { ::new (q) msg_t { 0, k }; });
+        }));
+        QVERIFY(forced);
+        QCOMPARE(c1.lost_, static_cast<std::size_t>(n + 1 + n + 1));
+        QCOMPARE(ca->conn_count(), std::size_t(2));
+        QVERIFY(pop(c2, msg));
+        QCOMPARE(msg.dat_, k);
+        QVERIFY(push(k + 1));
+        QVERIFY(pop(c1, msg));
+        QCOMPARE(msg.dat_, k + 1);
+
+        ca->disconnect_reader(c1);
+        ca->disconnect_reader(c2);
+        QCOMPARE(ca->conn_count(), std::size_t(0));
+    }
+
+    auto el_arr_smb = std::make_unique<ea_t<
+        sizeof(msg_t),
+        pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>
+    >>();
+    auto el_arr_cur = std::make_unique<ca_t>();
+    ipc::detail::static_for<8>([&](auto index) {
+        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(el_arr_smb.get());
+        benchmark_prod_cons<1, decltype(index)::value + 1, LoopCount, void>(el_arr_cur.get());
+    });
+    benchmark_prod_cons<1, 8, LoopCount, ca_t>(el_arr_cur.get()); // test & verify
+}
+
+void Unit::test_lossy_broadcast() {
+    // each element is filled with its sequence, so a torn one could be found
+    struct seq_t {
+        int v_[16];
+    };
+    using ca_t = ea_t<sizeof(seq_t), ipc::prod_cons_impl<ipc::wr_lossy>>;
+    auto push = [](ca_t* ca, int i) {
+        return ca->push([i](void* p) {
+            auto s = ::new (p) seq_t;
+            for (auto& v : s->v_) v = i;
+        });
+    };
+    auto pop = [](ca_t* ca, auto& cur, int& i) {
+        return ca->pop(&cur, [&i](void* p) {
+            auto s = static_cast<seq_t*>(p);
+            i = s->v_[0];
+            for (auto v : s->v_) if (v != i) i = -1;
+        });
+    };
+    {
+        auto ca = std::make_unique<ca_t>();
+        auto cur = ca->connect_reader();
+        int n = static_cast<int>(ipc::default_elem_max) * 3;
+        // the writer never waits
+        for (int i = 0; i < n; ++i) {
+            QVERIFY(push(ca.get(), i));
+        }
+        int i = -1;
+        QVERIFY(pop(ca.get(), cur, i));
+        int first = n - static_cast<int>(ipc::default_elem_max) + 1;
+        QCOMPARE(i, first);
+        QCOMPARE(cur.lost_, static_cast<std::size_t>(first));
+        for (int k = first + 1; k < n; ++k) {
+            QVERIFY(pop(ca.get(), cur, i));
+            QCOMPARE(i, k);
+        }
+        QVERIFY(!pop(ca.get(), cur, i));
+        QCOMPARE(cur.lost_, static_cast<std::size_t>(first));
+        ca->disconnect_reader(cur);
+    }
+
+    auto ca = std::make_unique<ca_t>();
+    constexpr int M = 4;
+    int const loops = LoopCount;
+    std::atomic<int> ready { 0 };
+    std::vector<std::thread> readers;
+    for (int r = 0; r < M; ++r) {
+        readers.emplace_back([&] {
+            auto cur = ca->connect_reader();
+            ++ready;
+            std::size_t got = 0;
+            int last = -1, i;
+            while (last != loops - 1) {
+                if (!pop(ca.get(), cur, i)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                QVERIFY(i > last); // neither torn nor out of order
+                last = i;
+                ++got;
+            }
+            QCOMPARE(got + cur.lost_, static_cast<std::size_t>(loops));
+            ca->disconnect_reader(cur);
+        });
+    }
+    while (ready != M) std::this_thread::yield();
+    for (int i = 0; i < loops; ++i) {
+        QVERIFY(push(ca.get(), i));
+    }
+    for (auto& t : readers) t.join();
+}
+
+template <typename Policy>
+void test_evict_policy() {
+    using ca_t = ea_t<sizeof(msg_t), Policy>;
+    auto ca = std::make_unique<ca_t>();
+    auto push = [&ca](int i) {
+        return ca->push([i](void* p) { ::new (p) msg_t { 0, i }; });
+    };
+    auto pop = [&ca](auto& cur, msg_t& msg) {
+        return ca->pop(&cur, [&msg](void* p) { msg = *static_cast<msg_t*>(p); });
+    };
+    QVERIFY(!push(0)); // no reader
+    auto c1 = ca->connect_reader();
+    auto c2 = ca->connect_reader();
+    QCOMPARE(ca->conn_count(), std::size_t(2));
+
+    // c1 is stuck, c2 reads everything
+    int n = 0;
+    msg_t msg {};
+    while (push(n)) {
+        QVERIFY(pop(c2, msg));
+        QCOMPARE(msg.dat_, n);
+        ++n;
+    }
+    QCOMPARE(n, static_cast<int>(ipc::default_elem_max));
+
+    // only c1 is evicted, c2 goes on without losing anything
+    QVERIFY(ca->force_push([n](void* p) { ::new (p) msg_t { 0, n }; }));
+    QCOMPARE(ca->conn_count(), std::size_t(1));
+    QVERIFY(pop(c2, msg));
+    QCOMPARE(msg.dat_, n);
+    QCOMPARE(c2.lost_, std::size_t(0));
+
+    // c1 is told it has been overrun, & rejoins from the newest element
+    QVERIFY(!pop(c1, msg));
+    QCOMPARE(c1.lost_, static_cast<std::size_t>(n + 1));
+    QCOMPARE(ca->conn_count(), std::size_t(2));
+    QVERIFY(push(n + 1));
+    QVERIFY(pop(c1, msg));
+    QCOMPARE(msg.dat_, n + 1);
+    QVERIFY(pop(c2, msg));
+    QCOMPARE(msg.dat_, n + 1);
+
+    ca->disconnect_reader(c1);
+    ca->disconnect_reader(c2);
+    QCOMPARE(ca->conn_count(), std::size_t(0));
+}
+
+void Unit::test_evict_reader() {
+    test_evict_policy<pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>();
+    test_evict_policy<pc_t<ipc::relat::multi , ipc::relat::multi, ipc::trans::broadcast>>();
+}
+
+template <typename Policy>
+void test_force_policy(int cap) {
+    using ca_t = ea_t<sizeof(msg_t), Policy>;
+    auto ca = std::make_unique<ca_t>();
+    auto cur = ca->connect_reader();
+    msg_t msg {};
+    auto pop = [&] {
+        return ca->pop(&cur, [&msg](void* p) { msg = *static_cast<msg_t*>(p); });
+    };
+
+    int n = 0;
+    while (ca->push([n](void* p) { ::new (p) msg_t { 0, n }; })) ++n;
+    QCOMPARE(n, cap);
+
+    // the oldest ones are dropped to make room
+    int const extra = 10;
+    for (int i = n; i < n + extra; ++i) {
+        QVERIFY(ca->force_push([i](void* p) { ::new (p) msg_t { 0, i }; }));
+    }
+    for (int i = extra; i < n + extra; ++i) {
+        QVERIFY(pop());
+        QCOMPARE(msg.dat_, i);
+    }
+    QVERIFY(!pop());
+    ca->disconnect_reader(cur);
+}
+
+// a producer stalled in the middle of the oldest element makes force_push fail, rather than hang
+template <typename Policy>
+void test_force_stalled(int cap) {
+    using ca_t = ea_t<sizeof(msg_t), Policy>;
+    auto ca = std::make_unique<ca_t>();
+    auto cur = ca->connect_reader();
+
+    std::atomic<bool> writing { false }, go { false };
+    std::thread stalled {[&] {
+        QVERIFY(ca->push([&](void* p) {
+            writing = true;
+            while (!go) std::this_thread::yield();
+            ::new (p) msg_t { 0, -1 };
+        }));
+    }};
+    while (!writing) std::this_thread::yield();
+    int n = 1;
+    while (ca->push([n](void* p) { ::new (p) msg_t { 0, n }; })) ++n;
+    QCOMPARE(n, cap);
+    QVERIFY(!ca->force_push([](void* p) { ::new (p) msg_t { 0, 0 }; }));
+
+    go = true;
+    stalled.join();
+    QVERIFY(ca->force_push([](void* p) { ::new (p) msg_t { 0, 0 }; }));
+    ca->disconnect_reader(cur);
+}
+
+void Unit::test_force_unicast() {
+    // one element of the rd/wt rings is always kept empty
+    test_force_policy<pc_t<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast>>(static_cast<int>(ipc::default_elem_max) - 1);
+    test_force_policy<pc_t<ipc::relat::multi , ipc::relat::multi, ipc::trans::unicast>>(static_cast<int>(ipc::default_elem_max) - 1);
+    test_force_policy<ipc::prod_cons_impl<ipc::wr_slot>>(static_cast<int>(ipc::default_elem_max));
+    test_force_stalled<pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>>(static_cast<int>(ipc::default_elem_max) - 1);
+    test_force_stalled<ipc::prod_cons_impl<ipc::wr_slot>>(static_cast<int>(ipc::default_elem_max));
+}
+
+/*
+ * The per-element sequences of wr_slot against the commit chain of mmu,
+ * N:1 & N:N up to the core count.
+*/
+void Unit::test_slot_performance() {
+    using mmu_t  = pc_t<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>;
+    using slot_t = ipc::prod_cons_impl<ipc::wr_slot>;
+
+    auto el_arr_mmu  = std::make_unique<ea_t<sizeof(msg_t), mmu_t >>();
+    auto el_arr_slot = std::make_unique<ea_t<sizeof(msg_t), slot_t>>();
+    benchmark_prod_cons<4, 4, LoopCount, slot_t>(el_arr_slot.get()); // test & verify
+
+    auto cores = (std::max)(std::thread::hardware_concurrency(), 1u);
+    ipc::detail::static_for<8>([&](auto index) {
+        constexpr int N = decltype(index)::value + 1;
+        if (static_cast<unsigned>(N) > cores) return;
+        benchmark_prod_cons<N, 1, LoopCount, void>(el_arr_mmu .get());
+        benchmark_prod_cons<N, 1, LoopCount, void>(el_arr_slot.get());
+        benchmark_prod_cons<N, N, LoopCount, void>(el_arr_mmu .get());
+        benchmark_prod_cons<N, N, LoopCount, void>(el_arr_slot.get());
+    });
+}
+
 } // internal-linkage
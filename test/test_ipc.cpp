@@ -1,4 +1,5 @@
 #include <thread>
+#include <chrono>
 #include <vector>
 #include <type_traits>
 #include <iostream>
@@ -12,12 +13,19 @@
 #include <array>
 #include <limits>
 #include <utility>
+#include <functional>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
 
 #include "stopwatch.hpp"
 #include "spin_lock.hpp"
 #include "random.hpp"
 
 #include "ipc.h"
+#include "scheduler.h"
+#include "dispatcher.h"
 #include "rw_lock.h"
 #include "memory/resource.h"
 
@@ -179,6 +187,28 @@ private slots:
     void test_channel();
     void test_channel_rtt();
     void test_channel_performance();
+    void test_data_size_performance();
+    void test_var_length();
+    void test_loan();
+    void test_recv_view();
+    void test_large_msg();
+    void test_batch();
+    void test_cursor_broadcast();
+    void test_lossy_broadcast();
+    void test_latest();
+    void test_evict_reader();
+    void test_overflow();
+    void test_slot_channel();
+    void test_sharded();
+    void test_wait_strategy();
+    void test_wait_stats();
+    void test_fragment_wake();
+    void test_ready_fd();
+    void test_poller();
+    void test_scheduler();
+    void test_coroutine();
+    void test_dispatcher();
+    void test_partitioned();
 } unit__;
 
 #include "test_ipc.moc"
@@ -479,4 +509,1289 @@ void Unit::test_channel_performance() {
     });
 }
 
+template <std::size_t DataSize>
+void benchmark_data_size(std::size_t msg_size) {
+    using route_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>, DataSize>;
+
+    std::cout << "benchmark_data_size: slot = " << DataSize << ", message = " << msg_size << std::endl;
+    std::string const name = "test-ipc-data-size-" + std::to_string(DataSize);
+    std::vector<ipc::byte_t> const msg(msg_size, 'x');
+    test_stopwatch sw;
+
+    std::thread t1 {[&] {
+        route_t cc { name.c_str(), ipc::receiver };
+        for (int i = 0; i < LoopCount; ++i) {
+            auto dd = cc.recv();
+            QCOMPARE(dd.size(), msg_size);
+        }
+        sw.print_elapsed(1, 1, LoopCount);
+    }};
+
+    route_t cc { name.c_str() };
+    cc.wait_for_recv(1);
+    sw.start();
+    for (int i = 0; i < LoopCount; ++i) {
+        cc.send(msg.data(), msg.size());
+    }
+    t1.join();
+}
+
+void Unit::test_data_size_performance() {
+    for (std::size_t msg_size : { 64, 256, 512, 1024, 4096 }) {
+        benchmark_data_size<ipc::data_length>(msg_size);
+        benchmark_data_size<256 >(msg_size);
+        benchmark_data_size<1024>(msg_size);
+        benchmark_data_size<4096>(msg_size);
+        benchmark_data_size<ipc::var_length>(msg_size);
+    }
+}
+
+template <typename Flag>
+void test_var_length_chan(char const * name) {
+    using chan_t = ipc::chan<Flag, ipc::var_length>;
+
+    std::vector<ipc::byte_t> large(10 * 1024);
+    for (std::size_t i = 0; i < large.size(); ++i) {
+        large[i] = static_cast<ipc::byte_t>(i);
+    }
+    std::size_t const count = static_cast<std::size_t>((std::min)(1000, LoopCount));
+
+    std::thread t1 {[&] {
+        chan_t cc { name, ipc::receiver };
+        for (std::size_t i = 0; i < count; ++i) {
+            ipc::buff_t dd = cc.recv();
+            QCOMPARE(dd, datas__[i]);
+        }
+        ipc::buff_t dd = cc.recv();
+        QCOMPARE(dd.size(), large.size());
+        QVERIFY(std::memcmp(dd.data(), large.data(), large.size()) == 0);
+    }};
+
+    chan_t cc { name };
+    cc.wait_for_recv(1);
+    for (std::size_t i = 0; i < count; ++i) {
+        QVERIFY(cc.send(datas__[i]));
+    }
+    QVERIFY(cc.send(large.data(), large.size()));
+    // a message must fit the ring as a whole
+    std::vector<ipc::byte_t> huge(ipc::default_elem_max * ipc::data_length);
+    QVERIFY(!cc.send(huge.data(), huge.size()));
+    t1.join();
+}
+
+void Unit::test_var_length() {
+    test_var_length_chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>("test-ipc-var-length-smb");
+    test_var_length_chan<ipc::wr<ipc::relat::multi , ipc::relat::multi, ipc::trans::broadcast>>("test-ipc-var-length-mmb");
+    test_var_length_chan<ipc::wr<ipc::relat::multi , ipc::relat::multi, ipc::trans::unicast  >>("test-ipc-var-length-mmu");
+}
+
+template <std::size_t DataSize>
+void test_loan_chan(char const * name) {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::multi, ipc::relat::multi, ipc::trans::broadcast>, DataSize>;
+
+    std::size_t const count = static_cast<std::size_t>((std::min)(1000, LoopCount));
+
+    std::thread t1 {[&] {
+        chan_t cc { name, ipc::receiver };
+        for (std::size_t i = 0; i < count; ++i) {
+            ipc::buff_t dd = cc.recv();
+            QCOMPARE(dd, datas__[i]);
+        }
+    }};
+
+    chan_t cc { name };
+    cc.wait_for_recv(1);
+    {
+        // an uncommitted loan is cancelled by disconnecting
+        chan_t cancelled { name };
+        QVERIFY(cancelled.loan(8) != nullptr);
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        auto p = cc.loan(datas__[i].size());
+        QVERIFY(p != nullptr);
+        QVERIFY(cc.loan(1) == nullptr); // only one at a time
+        std::memcpy(p, datas__[i].data(), datas__[i].size());
+        QVERIFY(cc.commit());
+    }
+    QVERIFY(!cc.commit());
+    t1.join();
+}
+
+void Unit::test_loan() {
+    test_loan_chan<ipc::data_length>("test-ipc-loan");
+    test_loan_chan<ipc::var_length >("test-ipc-loan-var-length");
+}
+
+template <std::size_t DataSize>
+void test_recv_view_chan(char const * name) {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>, DataSize>;
+
+    std::size_t const count = static_cast<std::size_t>((std::min)(1000, LoopCount));
+
+    std::thread t1 {[&] {
+        chan_t cc { name, ipc::receiver };
+        std::vector<ipc::buff_t> held;
+        for (std::size_t i = 0; i < count; ++i) {
+            ipc::buff_t dd = cc.recv_view();
+            QCOMPARE(dd, datas__[i]);
+            // holding a few views at a time
+            held.emplace_back(std::move(dd));
+            if (held.size() > 8) held.clear();
+        }
+    }};
+
+    chan_t cc { name };
+    cc.wait_for_recv(1);
+    for (std::size_t i = 0; i < count; ++i) {
+        QVERIFY(cc.send(datas__[i]));
+    }
+    t1.join();
+}
+
+/*
+ * A full var_length broadcast ring wouldn't drop a record being viewed,
+ * the forced send fails instead, & the view keeps its bytes.
+*/
+void test_recv_view_force() {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>, ipc::var_length>;
+
+    chan_t rd { "test-ipc-recv-view-force", ipc::receiver };
+    chan_t cc { "test-ipc-recv-view-force" };
+    int const first = 0;
+    QVERIFY(cc.send(&first, sizeof(first)));
+    ipc::buff_t dd = rd.recv_view();
+    QCOMPARE(dd.size(), sizeof(int));
+
+    int i = 1;
+    int const limit = static_cast<int>(ipc::default_elem_max) * 2;
+    while ((i < limit) && cc.send(&i, sizeof(i))) ++i;
+    QVERIFY(i < limit); // the forced send has failed
+    QCOMPARE(*static_cast<int const *>(dd.data()), first);
+    QCOMPARE(rd.lost_count(), std::size_t(0));
+
+    // once released, the ring is reclaimed (or the receiver evicted) as usual
+    dd = ipc::buff_t {};
+    QVERIFY(cc.send(&i, sizeof(i)));
+}
+
+void Unit::test_recv_view() {
+    test_recv_view_chan<ipc::data_length>("test-ipc-recv-view");
+    test_recv_view_chan<ipc::var_length >("test-ipc-recv-view-var-length");
+    test_recv_view_force();
+}
+
+template <typename Flag>
+void test_large_msg_chan(char const * name, int r_count) {
+    using chan_t = ipc::chan<Flag>;
+
+    constexpr std::size_t count = ipc::large_msg_cache * 4;
+    std::vector<ipc::buff_t> msgs;
+    capo::random<> bit { 0, (std::numeric_limits<ipc::byte_t>::max)() };
+    for (std::size_t i = 0; i < count; ++i) {
+        auto n = ipc::large_msg_limit + 1 + (i * 997) % (64 * 1024);
+        ipc::buff_t buff { new ipc::byte_t[n], n, [](void* p, std::size_t) {
+            delete [] static_cast<ipc::byte_t*>(p);
+        }};
+        for (std::size_t k = 0; k < n; ++k) {
+            static_cast<ipc::byte_t*>(buff.data())[k] = static_cast<ipc::byte_t>(bit());
+        }
+        msgs.emplace_back(std::move(buff));
+    }
+    std::size_t per_recv = std::is_same<Flag, ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>::value ?
+                           count : count / static_cast<std::size_t>(r_count);
+
+    std::vector<std::thread> receivers;
+    for (int r = 0; r < r_count; ++r) {
+        receivers.emplace_back([&] {
+            chan_t cc { name, ipc::receiver };
+            std::vector<ipc::buff_t> held;
+            std::size_t last = 0;
+            for (std::size_t i = 0; i < per_recv; ++i) {
+                ipc::buff_t dd = cc.recv();
+                auto it = std::find(msgs.begin() + static_cast<std::ptrdiff_t>(last), msgs.end(), dd);
+                QVERIFY(it != msgs.end());
+                last = static_cast<std::size_t>(it - msgs.begin()) + 1;
+                // holding more chunks than the cache, the sender would fall back to fragments
+                held.emplace_back(std::move(dd));
+                if (held.size() > ipc::large_msg_cache + 8) held.clear();
+            }
+        });
+    }
+
+    chan_t cc { name };
+    cc.wait_for_recv(static_cast<std::size_t>(r_count));
+    for (auto const & m : msgs) {
+        QVERIFY(cc.send(m));
+    }
+    for (auto& t : receivers) t.join();
+}
+
+/*
+ * The chunks of the messages nobody would read (a receiver has left, been evicted or overrun,
+ * or a unicast message has been dropped) go back as the rings go on,
+ * so the large messages sent later are still whole.
+*/
+void test_large_msg_release() {
+    std::size_t const size = ipc::large_msg_limit * 3;
+    int const count = static_cast<int>(ipc::default_elem_max) * 2;
+    std::vector<ipc::byte_t> data(size);
+    auto make = [&data](int i) {
+        for (std::size_t k = 0; k < data.size(); ++k) data[k] = static_cast<ipc::byte_t>(i + static_cast<int>(k));
+        std::memcpy(data.data(), &i, sizeof(i));
+        return data.data();
+    };
+    // the number of a whole message, or -1
+    auto check = [size](ipc::buff_t const & dd) {
+        if (dd.size() != size) return -1;
+        int i;
+        std::memcpy(&i, dd.data(), sizeof(i));
+        auto p = static_cast<ipc::byte_t const *>(dd.data());
+        for (std::size_t k = sizeof(i); k < size; ++k) {
+            if (p[k] != static_cast<ipc::byte_t>(i + static_cast<int>(k))) return -1;
+        }
+        return i;
+    };
+
+    // unicast: the oldest messages are dropped
+    {
+        using chan_t = ipc::chan<ipc::wr<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>>;
+        chan_t rd { "test-ipc-large-msg-drop", ipc::receiver };
+        chan_t cc { "test-ipc-large-msg-drop" };
+        cc.set_overflow(ipc::overflow::drop);
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(cc.send(make(i), size));
+        }
+        int last = -1;
+        for (ipc::buff_t dd; !(dd = rd.recv(0)).empty();) {
+            int i = check(dd);
+            QVERIFY(i > last);
+            last = i;
+        }
+        QCOMPARE(last, count - 1);
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(cc.send(make(i), size));
+            QCOMPARE(check(rd.recv(0)), i);
+        }
+    }
+
+    // broadcast: a receiver has left, & another one is evicted
+    {
+        using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>;
+        chan_t rd    { "test-ipc-large-msg-evict", ipc::receiver };
+        chan_t stuck { "test-ipc-large-msg-evict", ipc::receiver };
+        {
+            chan_t gone { "test-ipc-large-msg-evict", ipc::receiver };
+        }
+        chan_t cc { "test-ipc-large-msg-evict" };
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(cc.send(make(i), size));
+            QCOMPARE(check(rd.recv(0)), i);
+        }
+        QVERIFY(stuck.lost_count() == 0);
+        QVERIFY(stuck.recv(0).empty()); // goes on from the newest message
+        QVERIFY(stuck.lost_count() > 0);
+    }
+
+    // lossy: the receiver is overrun
+    {
+        using chan_t = ipc::chan<ipc::wr_lossy>;
+        chan_t rd { "test-ipc-large-msg-lossy", ipc::receiver };
+        chan_t cc { "test-ipc-large-msg-lossy" };
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(cc.send(make(i), size));
+        }
+        int last = -1;
+        for (ipc::buff_t dd; !(dd = rd.recv(0)).empty();) {
+            int i = check(dd);
+            QVERIFY(i > last);
+            last = i;
+        }
+        QCOMPARE(last, count - 1);
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(cc.send(make(i), size));
+            QCOMPARE(check(rd.recv(0)), i);
+        }
+    }
+}
+
+void Unit::test_large_msg() {
+    test_large_msg_chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>>("test-ipc-large-msg-smb", 3);
+    test_large_msg_chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast  >>("test-ipc-large-msg-smu", 1);
+    test_large_msg_release();
+}
+
+template <typename Flag, std::size_t DataSize>
+void test_batch_chan(char const * name) {
+    using chan_t = ipc::chan<Flag, DataSize>;
+
+    std::size_t const count = static_cast<std::size_t>((std::min)(2000, LoopCount));
+
+    std::thread t1 {[&] {
+        chan_t cc { name, ipc::receiver };
+        std::size_t i = 0;
+        while (i < count) {
+            auto buffs = cc.recv_batch(64);
+            QVERIFY(!buffs.empty());
+            QVERIFY(buffs.size() <= 64);
+            for (auto& dd : buffs) {
+                QCOMPARE(dd, datas__[i++]);
+            }
+        }
+    }};
+
+    chan_t cc { name };
+    cc.wait_for_recv(1);
+    // batches of the views on datas__, some of them larger than one fragment
+    for (std::size_t i = 0; i < count;) {
+        std::vector<ipc::buff_t> batch;
+        for (std::size_t k = 0; (k < 50) && (i < count); ++k, ++i) {
+            batch.emplace_back(datas__[i].data(), datas__[i].size());
+        }
+        QVERIFY(cc.send_batch(batch));
+    }
+    t1.join();
+}
+
+void Unit::test_batch() {
+    test_batch_chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::unicast  >, ipc::data_length>("test-ipc-batch-smu");
+    test_batch_chan<ipc::wr<ipc::relat::multi , ipc::relat::multi, ipc::trans::broadcast>, ipc::data_length>("test-ipc-batch-mmb");
+    test_batch_chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>, ipc::var_length >("test-ipc-batch-var-length");
+}
+
+void Unit::test_cursor_broadcast() {
+    using chan_t = ipc::chan<ipc::wr_cursor>;
+
+    constexpr int r_count = 3;
+    std::size_t const count = static_cast<std::size_t>((std::min)(2000, LoopCount));
+
+    std::vector<std::thread> receivers;
+    for (int r = 0; r < r_count; ++r) {
+        receivers.emplace_back([&] {
+            chan_t cc { "test-ipc-cursor", ipc::receiver };
+            for (std::size_t i = 0; i < count; ++i) {
+                ipc::buff_t dd = cc.recv();
+                QCOMPARE(dd, datas__[i]);
+            }
+        });
+    }
+
+    chan_t cc { "test-ipc-cursor" };
+    cc.wait_for_recv(r_count);
+    for (std::size_t i = 0; i < count; ++i) {
+        QVERIFY(cc.send(datas__[i]));
+    }
+    for (auto& t : receivers) t.join();
+}
+
+void Unit::test_lossy_broadcast() {
+    using chan_t = ipc::chan<ipc::wr_lossy>;
+
+    int const count = (std::max)(LoopCount, static_cast<int>(ipc::default_elem_max) * 4);
+
+    std::thread receiver {[&] {
+        chan_t cc { "test-ipc-lossy", ipc::receiver };
+        std::size_t got = 0;
+        int last = -1;
+        while (last != count - 1) {
+            ipc::buff_t dd = cc.recv();
+            QCOMPARE(dd.size(), sizeof(int));
+            int i = *static_cast<int const *>(dd.data());
+            QVERIFY(i > last);
+            last = i;
+            ++got;
+            // a slow reader, so the writer laps it
+            if ((got % 16) == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        QCOMPARE(got + cc.lost_count(), static_cast<std::size_t>(count));
+    }};
+
+    chan_t cc { "test-ipc-lossy" };
+    cc.wait_for_recv(1);
+    for (int i = 0; i < count; ++i) {
+        // never blocks on the reader
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    receiver.join();
+}
+
+void Unit::test_latest() {
+    // each value is filled with its sequence, so a torn one could be found
+    struct state_t {
+        int v_[16];
+    };
+    auto make = [](int i) {
+        state_t s;
+        for (auto& v : s.v_) v = i;
+        return s;
+    };
+    auto check = [](state_t const & s) {
+        for (auto v : s.v_) if (v != s.v_[0]) return -1;
+        return s.v_[0];
+    };
+    {
+        ipc::latest<state_t> wr { "test-ipc-latest" }, rd { "test-ipc-latest" };
+        QVERIFY(wr.valid() && rd.valid());
+        QVERIFY(!ipc::latest<int>{ "test-ipc-latest" }.valid()); // the size is decided
+        state_t s = make(-1);
+        QCOMPARE(rd.read(s), std::uint64_t { 0 });
+        QCOMPARE(rd.wait(0, 10), std::uint64_t { 0 });
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(wr.publish(make(i)));
+        }
+        QCOMPARE(rd.read(s), std::uint64_t { 10 });
+        QCOMPARE(check(s), 9);
+        QCOMPARE(rd.wait(9, 10), std::uint64_t { 10 });
+        QCOMPARE(rd.wait(10, 10), std::uint64_t { 0 });
+    }
+
+    int const count = LoopCount;
+    std::atomic<bool> ready { false };
+    std::thread reader {[&] {
+        ipc::latest<state_t> rd { "test-ipc-latest" };
+        ready = true;
+        std::uint64_t ver = 0;
+        int last = -1;
+        while (last != count - 1) {
+            ver = rd.wait(ver);
+            QVERIFY(ver != 0);
+            state_t s;
+            if ((ver = rd.read(s)) == 0) continue; // rewritten under the reader
+            int i = check(s);
+            QVERIFY(i >= last); // neither torn nor older
+            last = i;
+        }
+    }};
+    ipc::latest<state_t> wr { "test-ipc-latest" };
+    while (!ready) std::this_thread::yield();
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(wr.publish(make(i)));
+    }
+    reader.join();
+
+    // several publishers never tear a value, a publish only fails when both slots are taken
+    std::atomic<bool> done { false };
+    std::thread checker {[&] {
+        ipc::latest<state_t> rd { "test-ipc-latest" };
+        while (!done) {
+            state_t s;
+            if (rd.read(s) != 0) QVERIFY(check(s) >= 0);
+        }
+    }};
+    std::vector<std::thread> publishers;
+    std::atomic<int> failed { 0 };
+    for (int n = 0; n < 3; ++n) {
+        publishers.emplace_back([&, n] {
+            ipc::latest<state_t> pw { "test-ipc-latest" };
+            for (int i = 0; i < count; ++i) {
+                if (!pw.publish(make(count + i * 3 + n))) ++failed;
+            }
+        });
+    }
+    for (auto& t : publishers) t.join();
+    done = true;
+    checker.join();
+    QVERIFY(failed < count * 3);
+}
+
+/*
+ * A var_length ring evicts the stuck receiver without disconnecting it,
+ * & the later sends don't wait for it any more.
+*/
+void test_evict_var_length() {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::multi, ipc::trans::broadcast>, ipc::var_length>;
+    int const count = static_cast<int>(ipc::default_elem_max) + 8;
+
+    chan_t stuck { "test-ipc-evict-var-length", ipc::receiver };
+    chan_t fast  { "test-ipc-evict-var-length", ipc::receiver };
+    chan_t cc    { "test-ipc-evict-var-length" };
+    QCOMPARE(cc.recv_count(), std::size_t(2));
+
+    std::thread receiver {[&] {
+        for (int i = 0; i <= count * 2; ++i) {
+            ipc::buff_t dd = fast.recv();
+            QCOMPARE(dd.size(), sizeof(int));
+            QCOMPARE(*static_cast<int const *>(dd.data()), i);
+        }
+        QCOMPARE(fast.lost_count(), std::size_t(0));
+    }};
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    QCOMPARE(cc.recv_count(), std::size_t(2));
+    capo::stopwatch<> sw { true };
+    for (int i = count; i < count * 2; ++i) {
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() < static_cast<long long>(ipc::default_timeut) * 4);
+    QCOMPARE(cc.recv_count(), std::size_t(2));
+
+    // the stuck receiver goes on from the newest message, the skipped ones are counted once it reads
+    QVERIFY(stuck.recv(0).empty());
+    int const last = count * 2;
+    QVERIFY(cc.send(&last, sizeof(last)));
+    ipc::buff_t dd = stuck.recv();
+    QCOMPARE(dd.size(), sizeof(int));
+    QCOMPARE(*static_cast<int const *>(dd.data()), last);
+    QCOMPARE(stuck.lost_count(), static_cast<std::size_t>(last));
+    receiver.join();
+}
+
+void Unit::test_evict_reader() {
+    int const count = static_cast<int>(ipc::default_elem_max) + 8;
+
+    ipc::route stuck { "test-ipc-evict", ipc::receiver };
+    ipc::route fast  { "test-ipc-evict", ipc::receiver };
+    ipc::route cc    { "test-ipc-evict" };
+    QCOMPARE(cc.recv_count(), std::size_t(2));
+
+    std::thread receiver {[&] {
+        for (int i = 0; i <= count; ++i) {
+            ipc::buff_t dd = fast.recv();
+            QCOMPARE(dd.size(), sizeof(int));
+            QCOMPARE(*static_cast<int const *>(dd.data()), i);
+        }
+        QCOMPARE(fast.lost_count(), std::size_t(0));
+    }};
+    // the sender would be blocked by the stuck receiver once, then evicts it only
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    QCOMPARE(cc.recv_count(), std::size_t(1));
+
+    // the stuck receiver goes on from the newest message, & lost_count tells the skipped ones
+    QVERIFY(stuck.recv(0).empty());
+    QCOMPARE(stuck.lost_count(), static_cast<std::size_t>(count));
+    QCOMPARE(cc.recv_count(), std::size_t(2));
+    QVERIFY(cc.send(&count, sizeof(count)));
+    ipc::buff_t dd = stuck.recv();
+    QCOMPARE(dd.size(), sizeof(int));
+    QCOMPARE(*static_cast<int const *>(dd.data()), count);
+    receiver.join();
+
+    // a receiver beyond the reader registry (32 bits) fails to connect
+    std::size_t const reader_max = 32;
+    std::vector<ipc::route> more;
+    while (more.size() + 2 < reader_max) {
+        more.emplace_back("test-ipc-evict", ipc::receiver);
+        QVERIFY(more.back().valid());
+    }
+    QCOMPARE(cc.recv_count(), reader_max);
+    ipc::route extra;
+    QVERIFY(!extra.connect("test-ipc-evict", ipc::receiver));
+    QCOMPARE(cc.recv_count(), reader_max);
+
+    test_evict_var_length();
+}
+
+void Unit::test_overflow() {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>>;
+
+    chan_t rd { "test-ipc-overflow", ipc::receiver };
+    chan_t cc { "test-ipc-overflow" };
+    int const cap   = static_cast<int>(ipc::default_elem_max) - 1;
+    int const count = cap + 10;
+    auto recv_int = [&rd] {
+        ipc::buff_t dd = rd.recv(0);
+        return dd.empty() ? -1 : *static_cast<int const *>(dd.data());
+    };
+
+    // fail (the default of unicast): a send on the full ring fails after waiting
+    for (int i = 0; i < cap; ++i) {
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    QVERIFY(!cc.send(&cap, sizeof(cap)));
+    for (int i = 0; i < cap; ++i) {
+        QCOMPARE(recv_int(), i);
+    }
+    QCOMPARE(recv_int(), -1);
+
+    // drop: a send never waits, the oldest messages are dropped
+    cc.set_overflow(ipc::overflow::drop);
+    capo::stopwatch<> sw { true };
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() < static_cast<long long>(ipc::default_timeut));
+    for (int i = count - cap; i < count; ++i) {
+        QCOMPARE(recv_int(), i);
+    }
+    QCOMPARE(recv_int(), -1);
+
+    // fail: a send on the full ring fails after waiting
+    cc.set_overflow(ipc::overflow::fail);
+    for (int i = 0; i < cap; ++i) {
+        QVERIFY(cc.send(&i, sizeof(i)));
+    }
+    QVERIFY(!cc.send(&cap, sizeof(cap)));
+
+    // wait: a send on the full ring goes on after waiting
+    cc.set_overflow(ipc::overflow::wait);
+    QVERIFY(cc.send(&cap, sizeof(cap)));
+    for (int i = 1; i <= cap; ++i) {
+        QCOMPARE(recv_int(), i);
+    }
+    QCOMPARE(recv_int(), -1);
+
+    // a var_length ring drops its oldest records as well
+    using var_t = ipc::chan<ipc::wr<ipc::relat::multi, ipc::relat::multi, ipc::trans::unicast>, ipc::var_length>;
+    var_t vr { "test-ipc-overflow-var-length", ipc::receiver };
+    var_t vc { "test-ipc-overflow-var-length" };
+    int const v_count = static_cast<int>(ipc::default_elem_max) * 2;
+    vc.set_overflow(ipc::overflow::drop);
+    capo::stopwatch<> v_sw { true };
+    for (int i = 0; i < v_count; ++i) {
+        QVERIFY(vc.send(&i, sizeof(i)));
+    }
+    QVERIFY(v_sw.elapsed<std::chrono::milliseconds>() < static_cast<long long>(ipc::default_timeut));
+    int first = -1, next = -1;
+    for (ipc::buff_t dd; !(dd = vr.recv(0)).empty(); ++next) {
+        int v = *static_cast<int const *>(dd.data());
+        if (first < 0) first = next = v;
+        QCOMPARE(v, next);
+    }
+    QVERIFY(first > 0);
+    QCOMPARE(next, v_count);
+}
+
+void Unit::test_slot_channel() {
+    using chan_t = ipc::chan<ipc::wr_slot>;
+
+    constexpr int s_count = 2, r_count = 2;
+    int const count = (std::min)(2000, LoopCount);
+
+    std::atomic<std::uint64_t> sum { 0 };
+    std::atomic<int> got { 0 };
+    std::vector<std::thread> receivers;
+    for (int r = 0; r < r_count; ++r) {
+        receivers.emplace_back([&] {
+            chan_t cc { "test-ipc-slot", ipc::receiver };
+            while (got < s_count * count) {
+                ipc::buff_t dd = cc.recv(10);
+                if (dd.empty()) continue;
+                sum += static_cast<std::uint64_t>(*static_cast<int const *>(dd.data()));
+                ++got;
+            }
+        });
+    }
+    chan_t::wait_for_recv("test-ipc-slot", r_count);
+    std::vector<std::thread> senders;
+    for (int s = 0; s < s_count; ++s) {
+        senders.emplace_back([&] {
+            chan_t cc { "test-ipc-slot" };
+            for (int i = 0; i < count; ++i) {
+                QVERIFY(cc.send(&i, sizeof(i)));
+            }
+        });
+    }
+    for (auto& t : senders  ) t.join();
+    for (auto& t : receivers) t.join();
+    QCOMPARE(got.load(), s_count * count);
+    QCOMPARE(sum.load(), s_count * acc<std::uint64_t>(0, count - 1));
+}
+
+void Unit::test_sharded() {
+    {
+        ipc::sharded rd { "test-ipc-sharded-order", ipc::receiver };
+        ipc::sharded s1 { "test-ipc-sharded-order" };
+        ipc::sharded s2 { "test-ipc-sharded-order" };
+        QCOMPARE(rd.recv_count(), std::size_t(1));
+        // the receiver joins the shards while it's waiting
+        std::thread warm { [&rd] {
+            for (int n = 0; n < 2;) n += rd.recv(100).empty() ? 0 : 1;
+        } };
+        int const hello = -1;
+        QVERIFY(s1.send(&hello, sizeof(hello)));
+        QVERIFY(s2.send(&hello, sizeof(hello)));
+        warm.join();
+        for (int i : { 0, 1, 2 }) QVERIFY(s1.send(&i, sizeof(i)));
+        for (int i : { 3, 4, 5 }) QVERIFY(s2.send(&i, sizeof(i)));
+        QCOMPARE(rd.shard_count(), std::size_t(2));
+        auto recv_int = [&rd](bool ordered) {
+            ipc::buff_t dd = ordered ? rd.recv_ordered(0) : rd.try_recv();
+            return dd.empty() ? -1 : *static_cast<int const *>(dd.data());
+        };
+        // round-robin takes the shards in turn
+        for (int i : { 0, 3, 1, 4, 2, 5 }) QCOMPARE(recv_int(false), i);
+        QCOMPARE(recv_int(false), -1);
+        for (int i : { 0, 1, 2 }) QVERIFY(s1.send(&i, sizeof(i)));
+        for (int i : { 3, 4, 5 }) QVERIFY(s2.send(&i, sizeof(i)));
+        // ordered takes the earliest sent messages first
+        for (int i : { 0, 1, 2, 3, 4, 5 }) QCOMPARE(recv_int(true), i);
+        QCOMPARE(recv_int(true), -1);
+    }
+
+    constexpr int s_count = 4;
+    int const count = (std::min)(2000, LoopCount);
+    std::thread receiver { [count] {
+        ipc::sharded rd { "test-ipc-sharded", ipc::receiver };
+        std::vector<int> next(s_count, 0);
+        for (int got = 0; got < s_count * count;) {
+            ipc::buff_t dd = rd.recv(100);
+            if (dd.empty()) continue;
+            auto msg = static_cast<int const *>(dd.data());
+            // every sender's messages keep their order
+            QCOMPARE(msg[1], next[msg[0]]++);
+            ++got;
+        }
+    } };
+    ipc::sharded probe { "test-ipc-sharded" };
+    while (probe.recv_count() < 1) {
+        std::this_thread::yield();
+    }
+    std::vector<std::thread> senders;
+    for (int s = 0; s < s_count; ++s) {
+        senders.emplace_back([s, count] {
+            ipc::sharded cc { "test-ipc-sharded" };
+            for (int i = 0; i < count; ++i) {
+                int msg[] = { s, i };
+                QVERIFY(cc.send(msg, sizeof(msg)));
+            }
+        });
+    }
+    for (auto& t : senders) t.join();
+    receiver.join();
+}
+
+void Unit::test_wait_strategy() {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+
+    int const count = (std::min)(1000, LoopCount);
+    for (auto ws : { ipc::wait_strategy::spin    , ipc::wait_strategy::pause,
+                     ipc::wait_strategy::adaptive, ipc::wait_strategy::block }) {
+        chan_t rd { "test-ipc-wait", ipc::receiver };
+        rd.set_wait(ws);
+        // an empty ring times out in every strategy
+        capo::stopwatch<> sw { true };
+        QVERIFY(rd.recv(20).empty());
+        QVERIFY(sw.elapsed<std::chrono::milliseconds>() >= 15);
+
+        std::thread receiver { [&rd, count] {
+            for (int i = 0; i < count; ++i) {
+                ipc::buff_t dd = rd.recv();
+                QCOMPARE(dd.size(), sizeof(int));
+                QCOMPARE(*static_cast<int const *>(dd.data()), i);
+            }
+        } };
+        chan_t cc { "test-ipc-wait" };
+        cc.set_wait(ws);
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(cc.send(&i, sizeof(i)));
+        }
+        receiver.join();
+    }
+}
+
+void Unit::test_wait_stats() {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+
+    chan_t rd { "test-ipc-wait-stats", ipc::receiver };
+    chan_t cc { "test-ipc-wait-stats" };
+    auto init = rd.stats().spin_budget;
+    QVERIFY(init > 0);
+
+    // an idle ring parks the receiver sooner each time
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(rd.recv(10).empty());
+    }
+    auto st = rd.stats();
+    QCOMPARE(st.waits , std::uint64_t { 3 });
+    QCOMPARE(st.parked, std::uint64_t { 3 });
+    QCOMPARE(st.spun  , std::uint64_t { 0 });
+    QVERIFY(st.wait_ns >= std::uint64_t { 30 * 1000 * 1000 });
+    QCOMPARE(st.spin_budget, init / 8);
+
+    // neither a ready ring nor a poll is a wait
+    int const n = 1;
+    QVERIFY(cc.send(&n, sizeof(n)));
+    QVERIFY(!rd.recv().empty());
+    QVERIFY(rd.try_recv().empty());
+    QCOMPARE(rd.stats().waits, std::uint64_t { 3 });
+    QCOMPARE(cc.stats(ipc::sender).waits, std::uint64_t { 0 });
+
+    // a poll checks once, it never spins the budget
+    capo::stopwatch<> sw { true };
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(rd.try_recv().empty());
+    }
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() < 100);
+}
+
+void Unit::test_fragment_wake() {
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+
+    // 16 fragments through 4 slots, the sender & the receiver must wake each other in a message
+    constexpr std::size_t size = 16 * ipc::data_length;
+    constexpr int count = 50;
+    chan_t rd { "test-ipc-fragment-wake", ipc::receiver, 4 };
+    chan_t cc { "test-ipc-fragment-wake", ipc::sender  , 4 };
+    // blocking at once, so no wake-up could be covered by spinning
+    rd.set_wait(ipc::wait_strategy::block);
+    cc.set_wait(ipc::wait_strategy::block);
+    std::thread receiver { [&] {
+        for (int i = 0; i < count; ++i) {
+            ipc::buff_t dd = rd.recv();
+            QCOMPARE(dd.size(), size);
+            QCOMPARE(static_cast<ipc::byte_t const *>(dd.data())[size - 1], static_cast<ipc::byte_t>(i));
+        }
+    } };
+    std::vector<ipc::byte_t> msg(size);
+    capo::stopwatch<> sw { true };
+    for (int i = 0; i < count; ++i) {
+        std::fill(msg.begin(), msg.end(), static_cast<ipc::byte_t>(i));
+        QVERIFY(cc.send(msg.data(), msg.size()));
+    }
+    receiver.join();
+    // a missed wake-up costs a default_timeut
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() < static_cast<long long>(count * ipc::default_timeut / 4));
+}
+
+void Unit::test_ready_fd() {
+#if !defined(_WIN32)
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+
+    chan_t rd { "test-ipc-ready-fd", ipc::receiver };
+    chan_t cc { "test-ipc-ready-fd" };
+    rd.set_wait(ipc::wait_strategy::spin);
+    auto readable = [fd = rd.ready_fd()](int tm) {
+        pollfd pfd { fd, POLLIN, 0 };
+        return (::poll(&pfd, 1, tm) == 1) && (pfd.revents & POLLIN);
+    };
+    QVERIFY(rd.ready_fd() >= 0);
+    QCOMPARE(rd.ready_fd(), rd.ready_fd());
+
+    // not armed, not signaled
+    int n = 1;
+    QVERIFY(cc.send(&n, sizeof(n)));
+    QVERIFY(!readable(0));
+    QVERIFY(!rd.try_recv().empty());
+
+    // armed, signaled once by the next message
+    QVERIFY(rd.arm());
+    QVERIFY(!readable(0));
+    std::thread sender { [&cc] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for (int i = 0; i < 3; ++i) QVERIFY(cc.send(&i, sizeof(i)));
+    } };
+    QVERIFY(readable(1000));
+    sender.join();
+    for (int i = 0; i < 3; ++i) {
+        ipc::buff_t dd = rd.try_recv();
+        QVERIFY(!dd.empty());
+        QCOMPARE(*static_cast<int const *>(dd.data()), i);
+    }
+    QVERIFY(rd.try_recv().empty());
+
+    // arming takes the old signal
+    QVERIFY(rd.arm());
+    QVERIFY(!readable(0));
+#endif
+}
+
+void Unit::test_poller() {
+#if !defined(_WIN32)
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+
+    chan_t rds[3], ccs[3];
+    ipc::poller pl;
+    for (int i = 0; i < 3; ++i) {
+        auto name = "test-ipc-poller-" + std::to_string(i);
+        rds[i].connect(name.c_str(), ipc::receiver);
+        ccs[i].connect(name.c_str(), ipc::sender);
+        rds[i].set_wait(ipc::wait_strategy::spin);
+        QVERIFY(pl.add(rds[i]));
+    }
+    QVERIFY(pl.add(rds[0])); // added already
+    QCOMPARE(pl.size(), std::size_t { 3 });
+
+    // the new ones are returned at once
+    int n = 0;
+    QVERIFY(ccs[2].send(&n, sizeof(n)));
+    auto hs = pl.wait(0);
+    QCOMPARE(hs.size(), std::size_t { 3 });
+    QVERIFY(!rds[2].try_recv().empty());
+    for (auto& rd : rds) QVERIFY(rd.try_recv().empty());
+    QVERIFY(pl.wait(0).empty());
+
+    // only the one sent to
+    std::thread sender { [&ccs] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for (int i = 0; i < 3; ++i) QVERIFY(ccs[1].send(&i, sizeof(i)));
+    } };
+    hs = pl.wait(1000);
+    QCOMPARE(hs.size(), std::size_t { 1 });
+    QCOMPARE(hs[0], rds[1].handle());
+    sender.join();
+    for (int i = 0; i < 3; ++i) {
+        ipc::buff_t dd = rds[1].try_recv();
+        QVERIFY(!dd.empty());
+        QCOMPARE(*static_cast<int const *>(dd.data()), i);
+    }
+    QVERIFY(rds[1].try_recv().empty());
+    // re-armed by the wait, the signal of the later messages is harmless
+    hs = pl.wait(0);
+    QVERIFY(hs.size() <= 1);
+
+    pl.remove(rds[1]);
+    QCOMPARE(pl.size(), std::size_t { 2 });
+    QVERIFY(ccs[1].send(&n, sizeof(n)));
+    QVERIFY(pl.wait(50).empty());
+    QVERIFY(!rds[1].try_recv().empty());
+#endif
+}
+
+void Unit::test_scheduler() {
+#if !defined(_WIN32)
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+    constexpr int consumers = 64;
+    constexpr int loops     = 16;
+
+    chan_t rds[2], ccs[2];
+    for (int i = 0; i < 2; ++i) {
+        auto name = "test-ipc-scheduler-" + std::to_string(i);
+        rds[i].connect(name.c_str(), ipc::receiver, 4);
+        ccs[i].connect(name.c_str(), ipc::sender);
+    }
+
+    // many logical consumers on one thread, each one receives again after a message
+    ipc::scheduler sch;
+    std::vector<int> got[2];
+    std::function<void(int)> consume = [&](int i) {
+        QVERIFY(sch.async_recv(rds[i], [&, i](ipc::buff_t buf) {
+            QCOMPARE(buf.size(), sizeof(int));
+            got[i].push_back(*static_cast<int const *>(buf.data()));
+            if (static_cast<int>(got[i].size()) <= consumers * (loops - 1)) consume(i);
+        }));
+    };
+    for (int k = 0; k < consumers; ++k) {
+        consume(0);
+        consume(1);
+    }
+    QCOMPARE(sch.pending(), std::size_t { consumers * 2 });
+    QCOMPARE(sch.run_once(0), std::size_t { 0 });
+
+    std::thread sender { [&] {
+        for (int n = 0; n < consumers * loops; ++n) {
+            for (auto& cc : ccs) {
+                while (!cc.try_send(&n, sizeof(n))) std::this_thread::yield();
+            }
+        }
+    } };
+    sch.run();
+    sender.join();
+    for (auto& g : got) {
+        QCOMPARE(g.size(), std::size_t { consumers * loops });
+        for (int n = 0; n < consumers * loops; ++n) QCOMPARE(g[n], n);
+    }
+
+    // the sendings to a full ring are completed in order as the receiver takes the messages
+    int datas[16];
+    std::vector<int> sent;
+    for (int n = 0; n < 16; ++n) {
+        datas[n] = n;
+        QVERIFY(sch.async_send(ccs[0], ipc::buff_t { &datas[n], sizeof(int) }, [&sent, n](bool ok) {
+            QVERIFY(ok);
+            sent.push_back(n);
+        }));
+    }
+    std::thread receiver { [&] {
+        for (int n = 0; n < 16; ++n) {
+            ipc::buff_t buf = rds[0].recv(1000);
+            QCOMPARE(buf.size(), sizeof(int));
+            QCOMPARE(*static_cast<int const *>(buf.data()), n);
+        }
+    } };
+    sch.run();
+    receiver.join();
+    QCOMPARE(sent.size(), std::size_t { 16 });
+    for (int n = 0; n < 16; ++n) QCOMPARE(sent[n], n);
+
+    // the dropped ones are never completed
+    bool completed = false;
+    QVERIFY(sch.async_recv(rds[1], [&completed](ipc::buff_t) { completed = true; }));
+    sch.remove(rds[1]);
+    QCOMPARE(sch.pending(), std::size_t { 0 });
+    QVERIFY(ccs[1].send(&loops, sizeof(loops)));
+    QCOMPARE(sch.run_once(0), std::size_t { 0 });
+    QVERIFY(!completed);
+
+    // a sending which would never succeed is completed with false, so run returns
+    ipc::route lone { "test-ipc-scheduler-lone" };
+    int failed = 0;
+    QVERIFY(sch.async_send(lone, ipc::buff_t { &datas[0], sizeof(int) }, [&failed](bool ok) {
+        if (!ok) ++failed;
+    }));
+    sch.run();
+    QCOMPARE(failed, 1);
+    QCOMPARE(sch.pending(), std::size_t { 0 });
+
+    // the idle channels are checked without waiting, whatever their wait_strategy is
+    ipc::route idles[50];
+    for (int i = 0; i < 50; ++i) {
+        QVERIFY(idles[i].connect(("test-ipc-scheduler-idle-" + std::to_string(i)).c_str(), ipc::receiver));
+        QVERIFY(sch.async_recv(idles[i], [&completed](ipc::buff_t) { completed = true; }));
+    }
+    capo::stopwatch<> sw { true };
+    QCOMPARE(sch.run_once(0), std::size_t { 0 });
+    QCOMPARE(sch.run_once(0), std::size_t { 0 });
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() < 20);
+    QVERIFY(!completed);
+#endif
+}
+
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+
+// a coroutine started at once & destroyed at the end, enough for the tests
+struct co_task {
+    struct promise_type {
+        co_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend  () noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template <typename Chan>
+co_task co_consume(ipc::scheduler& sch, Chan& ch, int count, std::vector<int>& got) {
+    for (int i = 0; i < count; ++i) {
+        ipc::buff_t buf = co_await ipc::async_recv(sch, ch);
+        if (buf.size() != sizeof(int)) co_return;
+        got.push_back(*static_cast<int const *>(buf.data()));
+    }
+}
+
+template <typename Chan>
+co_task co_produce(ipc::scheduler& sch, Chan& ch, int count, int& sent) {
+    for (int i = 0; i < count; ++i) {
+        // i lives in the coroutine frame while it's suspended
+        if (!co_await ipc::async_send(sch, ch, &i, sizeof(i))) co_return;
+        ++sent;
+    }
+}
+
+#endif/*__cpp_impl_coroutine*/
+
+void Unit::test_coroutine() {
+#if !defined(_WIN32) && defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+    constexpr int count = 1000;
+
+    // both suspend on an empty or a full ring of 4 slots, & are resumed by the scheduler
+    chan_t rd { "test-ipc-coroutine", ipc::receiver, 4 };
+    chan_t cc { "test-ipc-coroutine", ipc::sender  , 4 };
+    ipc::scheduler sch;
+    std::vector<int> got;
+    int sent = 0;
+    co_consume(sch, rd, count, got);
+    QVERIFY(sch.pending() > 0);
+    co_produce(sch, cc, count, sent);
+    sch.run();
+    QCOMPARE(sent, count);
+    QCOMPARE(got.size(), std::size_t { count });
+    for (int i = 0; i < count; ++i) QCOMPARE(got[i], i);
+#else
+    QSKIP("no C++20 coroutine");
+#endif
+}
+
+void Unit::test_dispatcher() {
+#if !defined(_WIN32)
+    using chan_t = ipc::chan<ipc::wr<ipc::relat::single, ipc::relat::single, ipc::trans::unicast>>;
+    constexpr int chans = 4;
+    constexpr int count = 2000;
+
+    for (auto ws : { ipc::wait_strategy::adaptive, ipc::wait_strategy::block }) {
+        chan_t rds[chans], ccs[chans];
+        std::vector<int> got[chans];
+        std::thread::id ids[chans];
+        bool same_thread[chans] = { true, true, true, true };
+
+        ipc::dispatcher dp { 2, 8, true };
+        dp.set_wait(ws);
+        QVERIFY(!dp.start()); // no channel
+        for (int i = 0; i < chans; ++i) {
+            auto name = "test-ipc-dispatcher-" + std::to_string(i);
+            rds[i].connect(name.c_str(), ipc::receiver, 16);
+            ccs[i].connect(name.c_str(), ipc::sender);
+            QVERIFY(dp.add(rds[i], [&, i](ipc::buff_t buf) {
+                if (ids[i] == std::thread::id{}) ids[i] = std::this_thread::get_id();
+                same_thread[i] = same_thread[i] && (ids[i] == std::this_thread::get_id());
+                got[i].push_back(*static_cast<int const *>(buf.data()));
+            }));
+        }
+        QVERIFY(!dp.add(rds[0], [](ipc::buff_t) {}));
+        QCOMPARE(dp.size(), std::size_t { chans });
+        QVERIFY(dp.start());
+        QVERIFY(!dp.add(rds[0], [](ipc::buff_t) {})); // running
+
+        std::thread senders[chans];
+        for (int i = 0; i < chans; ++i) {
+            senders[i] = std::thread { [&, i] {
+                for (int n = 0; n < count; ++n) {
+                    while (!ccs[i].try_send(&n, sizeof(n))) std::this_thread::yield();
+                }
+            } };
+        }
+        for (auto& t : senders) t.join();
+        capo::stopwatch<> sw { true };
+        while ((dp.dispatched() < std::size_t { chans * count }) &&
+               (sw.elapsed<std::chrono::milliseconds>() < 10000)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        dp.stop();
+        QVERIFY(!dp.running());
+        QCOMPARE(dp.dispatched(), std::size_t { chans * count });
+        for (int i = 0; i < chans; ++i) {
+            QVERIFY(same_thread[i]);
+            QCOMPARE(got[i].size(), std::size_t { count });
+            for (int n = 0; n < count; ++n) QCOMPARE(got[i][n], n);
+        }
+    }
+
+    // the idle channels signaled at the start don't delay the busy one
+    ipc::route idles[50];
+    chan_t rd { "test-ipc-dispatcher-busy", ipc::receiver };
+    chan_t cc { "test-ipc-dispatcher-busy" };
+    ipc::dispatcher dp;
+    for (int i = 0; i < 50; ++i) {
+        QVERIFY(idles[i].connect(("test-ipc-dispatcher-idle-" + std::to_string(i)).c_str(), ipc::receiver));
+        QVERIFY(dp.add(idles[i], [](ipc::buff_t) {}));
+    }
+    QVERIFY(dp.add(rd, [](ipc::buff_t) {}));
+    QVERIFY(dp.start());
+    capo::stopwatch<> sw { true };
+    QVERIFY(cc.send(&count, sizeof(count)));
+    while ((dp.dispatched() == 0) && (sw.elapsed<std::chrono::milliseconds>() < 1000)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    QCOMPARE(dp.dispatched(), std::size_t { 1 });
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() < 50);
+    dp.stop();
+#endif
+}
+
+void Unit::test_partitioned() {
+    constexpr int keys  = 16;
+    constexpr int count = 200;
+    struct msg_t { int key, seq; };
+
+    ipc::partitioned rds[2] {
+        ipc::partitioned { "test-ipc-partitioned", ipc::receiver, 8, 64 },
+        ipc::partitioned { "test-ipc-partitioned", ipc::receiver, 4 } // the recorded count is used
+    };
+    ipc::partitioned cc { "test-ipc-partitioned" };
+    QCOMPARE(cc.part_count(), std::size_t { 8 });
+    QCOMPARE(rds[1].part_count(), std::size_t { 8 });
+    QCOMPARE(cc.recv_count(), std::size_t { 2 });
+
+    // each key goes to one receiver, in order
+    std::atomic_int total { 0 };
+    std::vector<int> seqs[2][keys];
+    std::thread receivers[2];
+    for (int i = 0; i < 2; ++i) {
+        receivers[i] = std::thread { [&, i] {
+            while (total.load() < keys * count) {
+                ipc::buff_t buf = rds[i].recv(100);
+                if (buf.empty()) continue;
+                QCOMPARE(buf.size(), sizeof(msg_t));
+                auto msg = static_cast<msg_t const *>(buf.data());
+                seqs[i][msg->key].push_back(msg->seq);
+                ++total;
+            }
+        } };
+    }
+    for (int n = 0; n < count; ++n) {
+        for (int k = 0; k < keys; ++k) {
+            msg_t msg { k, n };
+            QVERIFY(cc.send(static_cast<std::uint64_t>(k), &msg, sizeof(msg)));
+        }
+    }
+    for (auto& t : receivers) t.join();
+    QCOMPARE(total.load(), keys * count);
+    QCOMPARE(rds[0].owned() + rds[1].owned(), std::size_t { 8 });
+    QCOMPARE(rds[0].owned(), std::size_t { 4 });
+    for (int k = 0; k < keys; ++k) {
+        QVERIFY(seqs[0][k].empty() != seqs[1][k].empty());
+        auto& seq = seqs[0][k].empty() ? seqs[1][k] : seqs[0][k];
+        QCOMPARE(seq.size(), std::size_t { count });
+        for (int n = 0; n < count; ++n) QCOMPARE(seq[n], n);
+    }
+
+    // the one left takes all the partitions
+    rds[1].disconnect();
+    QCOMPARE(cc.recv_count(), std::size_t { 1 });
+    QVERIFY(cc.send(std::string { "key" }, std::string { "leave" }));
+    ipc::buff_t buf = rds[0].recv(1000);
+    QVERIFY(!buf.empty());
+    QCOMPARE(std::string { static_cast<char const *>(buf.data()) }, std::string { "leave" });
+    QCOMPARE(rds[0].owned(), std::size_t { 8 });
+
+    // & gives up half of them to a new one
+    QVERIFY(rds[1].connect("test-ipc-partitioned", ipc::receiver));
+    QVERIFY(rds[1].try_recv().empty());
+    QCOMPARE(rds[1].owned(), std::size_t { 0 }); // not given up yet
+    QVERIFY(rds[0].try_recv().empty());
+    QCOMPARE(rds[0].owned(), std::size_t { 4 });
+    QVERIFY(rds[1].try_recv().empty());
+    QCOMPARE(rds[1].owned(), std::size_t { 4 });
+
+    // a partly received message is finished before its partition moves
+    ipc::partitioned rd0 { "test-ipc-partitioned-move", ipc::receiver, 2, 8 };
+    ipc::partitioned rd1 { "test-ipc-partitioned-move", ipc::receiver, 2, 8 };
+    ipc::partitioned snd { "test-ipc-partitioned-move", ipc::sender,   2, 8 };
+    QVERIFY(rd0.try_recv().empty());
+    QVERIFY(rd1.try_recv().empty());
+    QCOMPARE(rd1.owned(), std::size_t { 1 });
+    std::uint64_t key = 0; // a key of the partition of rd1
+    for (;; ++key) {
+        QVERIFY(snd.send(key, &key, sizeof(key)));
+        if (!rd1.try_recv().empty()) break;
+        QVERIFY(!rd0.try_recv().empty());
+    }
+    rd1.disconnect();
+    QVERIFY(rd0.try_recv().empty());
+    QCOMPARE(rd0.owned(), std::size_t { 2 });
+
+    std::string big(ipc::large_msg_limit, '\0'); // twice the fragments of the ring
+    for (std::size_t n = 0; n < big.size(); ++n) big[n] = static_cast<char>(n % 251);
+    std::thread sender { [&] {
+        QVERIFY(snd.send(key, big.data(), big.size()));
+    } };
+    std::this_thread::sleep_for(std::chrono::milliseconds(20)); // the sender waits for the ring
+    buf = rd0.try_recv();
+    QVERIFY(rd1.connect("test-ipc-partitioned-move", ipc::receiver));
+    if (buf.empty()) buf = rd0.recv(1000);
+    QVERIFY(rd0.try_recv().empty());
+    QCOMPARE(rd0.owned(), std::size_t { 1 });
+    QVERIFY(rd1.try_recv().empty());
+    QCOMPARE(rd1.owned(), std::size_t { 1 });
+    sender.join();
+    QCOMPARE(buf.size(), big.size());
+    QVERIFY(std::memcmp(buf.data(), big.data(), big.size()) == 0);
+
+    // a sender to a full partition having no owner waits for the next one
+    rd1.disconnect();
+    sender = std::thread { [&] {
+        for (int n = 0; n < 12; ++n) QVERIFY(snd.send(key, &n, sizeof(n)));
+    } };
+    std::this_thread::sleep_for(std::chrono::milliseconds(ipc::default_timeut * 3));
+    for (int n = 0; n < 12; ++n) {
+        buf = rd0.recv(1000);
+        QCOMPARE(buf.size(), sizeof(n));
+        QCOMPARE(*static_cast<int const *>(buf.data()), n);
+    }
+    sender.join();
+
+    // but fails in the end if the next owner never comes, as if its receiver had died
+    QVERIFY(rd1.connect("test-ipc-partitioned-move", ipc::receiver));
+    QVERIFY(rd0.try_recv().empty());
+    QCOMPARE(rd0.owned(), std::size_t { 1 });
+    capo::stopwatch<> sw { true };
+    int n = 0;
+    while ((n < 64) && snd.send(key, &n, sizeof(n))) ++n;
+    QVERIFY(n < 64);
+    QVERIFY(sw.elapsed<std::chrono::milliseconds>() >=
+            static_cast<long long>(ipc::default_timeut) * (ipc::part_impl::move_wait - 1));
+}
+
 } // internal-linkage
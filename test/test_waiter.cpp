@@ -1,5 +1,7 @@
 #include <thread>
 #include <iostream>
+#include <atomic>
+#include <chrono>
 
 #include "platform/waiter_wrapper.h"
 #include "test.h"
@@ -15,6 +17,7 @@ class Unit : public TestSuite {
 
 private slots:
     void test_broadcast();
+    void test_notify();
 } unit__;
 
 #include "test_waiter.moc"
@@ -43,4 +46,39 @@ void Unit::test_broadcast() {
     wp.close();
 }
 
+void Unit::test_notify() {
+    ipc::detail::waiter w;
+    ipc::detail::waiter_wrapper wp { &w };
+    QVERIFY(wp.open("test-ipc-waiter-notify"));
+
+    // nobody notifies, it's a timeout
+    auto t0 = std::chrono::steady_clock::now();
+    QVERIFY(!wp.wait_if([] { return true; }, 100));
+    QVERIFY(std::chrono::steady_clock::now() - t0 >= std::chrono::milliseconds(90));
+
+    // a false pred returns at once
+    QVERIFY(wp.wait_if([] { return false; }, 0));
+
+    // notify wakes a waiter each time
+    std::atomic<int> woken { 0 };
+    std::thread ts[2];
+    for (auto& t : ts) {
+        t = std::thread([&w, &woken] {
+            ipc::detail::waiter_wrapper wp { &w };
+            QVERIFY(wp.open("test-ipc-waiter-notify"));
+            while (!wp.wait_if([] { return true; })) ;
+            ++woken;
+        });
+    }
+    for (int n = 1; n <= 2; ++n) {
+        while (woken < n) {
+            QVERIFY(wp.notify());
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    for (auto& t : ts) t.join();
+    QCOMPARE(woken.load(), 2);
+    wp.close();
+}
+
 } // internal-linkage